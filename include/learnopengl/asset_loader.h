@@ -0,0 +1,257 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <learnopengl/model.h>
+#include <learnopengl/resources.h>
+#include <learnopengl/texture.h>
+#include <rg/Profiler.h>
+#include <rg/ResourceManager.h>
+#include <rg/ThreadPool.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Loads models and textures in parallel. Model imports, image decodes and texture compression run on a pool
+// of worker threads; each finished piece of CPU work queues a GL upload, and the uploads are run on the thread
+// that calls Finish(), which must be the one with the GL context. Nothing is uploaded before Finish() is called.
+// DetectTextureCompression() has to run before the first texture is requested.
+//
+// Textures go through the rg::ResourceManager: the first request for a file loads it and every other request,
+// from this model or another one, waits for that load and shares the result.
+//
+//     AssetLoader loader;
+//     Model hut;
+//     loader.LoadModel(hut, "resources/objects/hut/woodshed.obj");
+//     loader.LoadTexture(grassTexture, FileSystem::getPath("resources/textures/grassD.jpg"));
+//     ... compile shaders, create framebuffers ...
+//     loader.Finish();
+//
+// The model objects and texture id variables are written during Finish(), so they must outlive it.
+class AssetLoader
+{
+public:
+    explicit AssetLoader(unsigned int threadCount = std::thread::hardware_concurrency()) : pool(threadCount)
+    {
+    }
+
+    void LoadModel(Model &model, const string &path)
+    {
+        submit([this, &model, path]()
+        {
+            shared_ptr<ModelData> data = make_shared<ModelData>();
+            if (!Model::Import(path, *data))
+                return;
+
+            // meshes are queued before their textures, so they exist by the time SetTexture runs
+            postUpload([&model, data]() { model.Upload(*data); });
+
+            // one decode job per distinct texture of the model, compressed for the first type it's used as
+            vector<TextureRef> textures;
+            for (const MeshData &mesh : data->meshes)
+                for (const TextureRef &texture : mesh.textures)
+                    if (std::find_if(textures.begin(), textures.end(),
+                                     [&](const TextureRef &other) { return other.path == texture.path; }) == textures.end())
+                        textures.push_back(texture);
+            for (const TextureRef &texture : textures)
+            {
+                string texturePath = texture.path;
+                string fullPath = data->directory + '/' + texturePath;
+                TextureUsage usage = TextureUsageFor(texture.type);
+                rg::TextureHandle handle = loadTexture(fullPath, usage);
+                postWhenResident(handle, [&model, texturePath, handle]() { model.SetTexture(texturePath, handle); });
+            }
+        });
+    }
+
+    // the returned handle holds a reference to the texture for the caller
+    rg::TextureHandle LoadTexture(unsigned int &textureID, const string &path, TextureUsage usage = TEXTURE_COLOR)
+    {
+        textureID = 0;
+        rg::TextureHandle handle = loadTexture(path, usage);
+        postWhenResident(handle, [&textureID, handle]() { textureID = rg::Resources().Textures().Get(handle).id; });
+        return handle;
+    }
+
+    // faces in +X, -X, +Y, -Y, +Z, -Z order; every face is decoded by its own job and the cubemap is uploaded
+    // once the last one is done
+    rg::TextureHandle LoadCubemap(unsigned int &textureID, const vector<string> &faces)
+    {
+        struct PendingCubemap {
+            vector<ImageData> faces;
+            unsigned int remaining;
+            std::mutex mutex;
+        };
+        textureID = 0;
+        bool created;
+        rg::TextureHandle handle = rg::Resources().Textures().Acquire(CubemapKey(faces), created);
+        postWhenResident(handle, [&textureID, handle]() { textureID = rg::Resources().Textures().Get(handle).id; });
+        if (!created)
+            return handle;
+
+        shared_ptr<PendingCubemap> cubemap = make_shared<PendingCubemap>();
+        cubemap->faces.resize(faces.size());
+        cubemap->remaining = faces.size();
+        for (unsigned int i = 0; i < faces.size(); i++)
+        {
+            string path = faces[i];
+            submit([this, handle, cubemap, i, path]()
+            {
+                ImageData image = DecodeImage(path);
+                std::lock_guard<std::mutex> lock(cubemap->mutex);
+                cubemap->faces[i] = std::move(image);
+                if (--cubemap->remaining == 0)
+                {
+                    postUpload([handle, cubemap]()
+                    {
+                        size_t bytes = 0;
+                        for (const ImageData &face : cubemap->faces)
+                            bytes += (size_t)face.width * face.height * 3;
+                        rg::Resources().Textures().Set(handle, rg::TextureResource{UploadCubemap(cubemap->faces), GL_TEXTURE_CUBE_MAP, bytes});
+                    });
+                }
+            });
+        }
+        return handle;
+    }
+
+    // runs the queued uploads on the calling thread until every requested asset is loaded; while nothing is
+    // ready to upload the calling thread helps the workers with decoding and importing
+    void Finish()
+    {
+        RG_PROFILE_ZONE("finish loading");
+        for (;;)
+        {
+            std::function<void()> upload;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!uploads.empty())
+                {
+                    upload = std::move(uploads.front());
+                    uploads.pop_front();
+                }
+                else if (pending == 0)
+                    return;
+            }
+            if (upload)
+            {
+                upload();
+                finished();
+                runResidentWaiters();
+                continue;
+            }
+            if (pool.RunPending())
+                continue;
+
+            // time spent here is the main thread waiting on the workers
+            RG_PROFILE_ZONE("wait for workers");
+            std::unique_lock<std::mutex> lock(mutex);
+            signal.wait(lock, [this]() { return !uploads.empty() || pending == 0; });
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable signal;
+    // GL work waiting for the main thread
+    std::deque<std::function<void()>> uploads;
+    // uploads that need a texture another request is still loading; only touched on the main thread
+    vector<pair<rg::TextureHandle, std::function<void()>>> waiting;
+    // jobs and uploads that were requested but haven't finished yet
+    unsigned int pending = 0;
+    // declared last so the workers are joined before the state they report to is destroyed
+    rg::ThreadPool pool;
+
+    void submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending++;
+        }
+        pool.Submit([this, job]()
+        {
+            job();
+            finished();
+        });
+    }
+
+    void postUpload(std::function<void()> upload)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending++;
+            uploads.push_back(std::move(upload));
+        }
+        signal.notify_all();
+    }
+
+    // claims the registry entry of a texture and, if this is the first request for it, loads it
+    rg::TextureHandle loadTexture(const string &path, TextureUsage usage)
+    {
+        bool created;
+        rg::TextureHandle handle = rg::Resources().Textures().Acquire(TextureKey(path, usage), created);
+        if (created)
+        {
+            submit([this, handle, path, usage]()
+            {
+                shared_ptr<TextureData> prepared = make_shared<TextureData>(PrepareTexture(path, usage));
+                postUpload([handle, prepared]()
+                {
+                    rg::Resources().Textures().Set(handle, rg::TextureResource{UploadTexture(*prepared), GL_TEXTURE_2D, prepared->GpuBytes()});
+                });
+            });
+        }
+        return handle;
+    }
+
+    // queues an upload that runs once the texture is resident. It goes through the upload queue first so it keeps
+    // its order relative to uploads posted before it (a model's meshes exist before its textures are set).
+    void postWhenResident(rg::TextureHandle handle, std::function<void()> upload)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending++;
+        }
+        postUpload([this, handle, upload]()
+        {
+            if (rg::Resources().Textures().IsResident(handle))
+            {
+                upload();
+                finished();
+            }
+            else
+                waiting.emplace_back(handle, upload);
+        });
+    }
+
+    void runResidentWaiters()
+    {
+        for (unsigned int i = 0; i < waiting.size();)
+        {
+            if (rg::Resources().Textures().IsResident(waiting[i].first))
+            {
+                std::function<void()> upload = std::move(waiting[i].second);
+                waiting.erase(waiting.begin() + i);
+                upload();
+                finished();
+            }
+            else
+                i++;
+        }
+    }
+
+    void finished()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+        }
+        signal.notify_all();
+    }
+};
+#endif
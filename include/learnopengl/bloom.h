@@ -0,0 +1,142 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/resources.h>
+#include <learnopengl/shader.h>
+#include <rg/GLState.h>
+
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// Progressive (dual-filter) bloom. The bright pass is downsampled with a 13-tap filter into a chain of
+// half-sized mips, then the chain is walked back up with a 3x3 tent filter, each level blended additively
+// into the next larger one. Every pass reads a quarter of the pixels it writes or fewer, so a wide radius
+// costs a fraction of a separable Gaussian at full resolution.
+class BloomMipChain
+{
+public:
+    struct Mip
+    {
+        glm::ivec2 size;
+        unsigned int texture;
+    };
+
+    // mipCount levels starting at half of width x height; 5 goes down to 1/32
+    BloomMipChain(unsigned int width, unsigned int height, unsigned int mipCount = 5)
+        : downsampleShader(AcquireShader("resources/shaders/bloom_mip.vs", "resources/shaders/bloom_downsample.fs")),
+          upsampleShader(AcquireShader("resources/shaders/bloom_mip.vs", "resources/shaders/bloom_upsample.fs"))
+    {
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glm::ivec2 size(width, height);
+        for (unsigned int i = 0; i < mipCount; i++)
+        {
+            size.x = size.x > 1 ? size.x / 2 : 1;
+            size.y = size.y > 1 ? size.y / 2 : 1;
+            Mip mip;
+            mip.size = size;
+            glGenTextures(1, &mip.texture);
+            glBindTexture(GL_TEXTURE_2D, mip.texture);
+            // no alpha and 32 bits per texel: half the bandwidth of RGBA16F, and bloom doesn't need the precision
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, size.x, size.y, 0, GL_RGB, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            mips.push_back(mip);
+        }
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mips[0].texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::BLOOM:: framebuffer not complete" << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // the full screen triangle is generated from gl_VertexID, but core profile still wants a VAO bound
+        glGenVertexArrays(1, &VAO);
+
+        downsampleShader.use();
+        downsampleShader.setInt("srcTexture", 0);
+        upsampleShader.use();
+        upsampleShader.setInt("srcTexture", 0);
+        srcTexelSize = downsampleShader.uniform<glm::vec2>("srcTexelSize");
+        firstPass = downsampleShader.uniform<bool>("firstPass");
+        upsampleTexelSize = upsampleShader.uniform<glm::vec2>("srcTexelSize");
+        filterRadius = upsampleShader.uniform<float>("filterRadius");
+        rg::State().Invalidate();
+    }
+
+    // runs the chain over the bright pass; leaves the result in Texture(), the framebuffer unbound and the
+    // viewport as it found it
+    void Render(unsigned int brightTexture, glm::ivec2 brightSize, float radius = 1.0f)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        rg::State().BindVertexArray(VAO);
+
+        // downsample: bright pass -> mip 0 -> mip 1 -> ...
+        downsampleShader.use();
+        unsigned int source = brightTexture;
+        glm::ivec2 sourceSize = brightSize;
+        for (unsigned int i = 0; i < mips.size(); i++)
+        {
+            downsampleShader.set(srcTexelSize, 1.0f / glm::vec2(sourceSize));
+            downsampleShader.set(firstPass, i == 0);
+            drawInto(mips[i], source);
+            source = mips[i].texture;
+            sourceSize = mips[i].size;
+        }
+
+        // upsample: every level is added onto the one above it, so mip 0 ends up with the sum of all of them
+        upsampleShader.use();
+        upsampleShader.set(filterRadius, radius);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glBlendEquation(GL_FUNC_ADD);
+        for (unsigned int i = mips.size() - 1; i > 0; i--)
+        {
+            upsampleShader.set(upsampleTexelSize, 1.0f / glm::vec2(mips[i].size));
+            drawInto(mips[i - 1], mips[i].texture);
+        }
+        glDisable(GL_BLEND);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    // the blurred bright pass, at half resolution
+    unsigned int Texture() const
+    {
+        return mips[0].texture;
+    }
+
+    // mip 0 holds the sum of every level; scaling by this keeps the overall bloom energy of a single blur
+    float Normalization() const
+    {
+        return 1.0f / mips.size();
+    }
+
+private:
+    unsigned int FBO = 0;
+    unsigned int VAO = 0;
+    vector<Mip> mips;
+    Shader downsampleShader;
+    Shader upsampleShader;
+    rg::Uniform<glm::vec2> srcTexelSize;
+    rg::Uniform<bool> firstPass;
+    rg::Uniform<glm::vec2> upsampleTexelSize;
+    rg::Uniform<float> filterRadius;
+
+    void drawInto(const Mip &target, unsigned int source)
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+        glViewport(0, 0, target.size.x, target.size.y);
+        rg::State().BindTexture(0, GL_TEXTURE_2D, source);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+};
+#endif
@@ -0,0 +1,223 @@
+#ifndef CLUSTERED_H
+#define CLUSTERED_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/GLState.h>
+#include <rg/UniformBuffer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+using namespace std;
+
+// Clustered point light lists for the forward shaders, which unlike the deferred path also light transparent
+// geometry. The view frustum is cut into froxels, CLUSTERS_X x CLUSTERS_Y screen tiles times CLUSTERS_Z depth
+// slices spaced exponentially, and every frame each light is listed in every froxel that the screen and depth
+// bounds of its sphere touch. A fragment looks up its froxel from gl_FragCoord and only loops over that list
+// (resources/shaders/clustered_lights.glsl), so its cost follows the lights near it, not all lights in the scene.
+//
+// GL 3.3 has neither compute shaders nor storage buffers, so the grid is built on the CPU and read through
+// texture buffers:
+//     clusterGrid          RG32UI, per froxel the offset of its list and the number of lights in it
+//     clusterLightIndices  R16UI, all lists one after another
+//     clusterLights        RGBA32F, four texels per light in the PointLightBlock layout, radius in the padding
+class ClusteredLights
+{
+public:
+    // texture units of the three buffers, clear of the ones the materials use
+    static const unsigned int GRID_UNIT = 8;
+    static const unsigned int INDEX_UNIT = 9;
+    static const unsigned int LIGHT_UNIT = 10;
+    // the light lists hold 16 bit indices
+    static const unsigned int MAX_POINT_LIGHTS = 65536;
+
+    ClusteredLights(unsigned int width, unsigned int height)
+        : width(width), height(height), clustersBuffer(rg::CLUSTERS_BLOCK_BINDING),
+          grid(rg::CLUSTERS_X * rg::CLUSTERS_Y * rg::CLUSTERS_Z)
+    {
+        createBuffer(gridBuffer, gridTexture, GL_RG32UI);
+        createBuffer(indexBuffer, indexTexture, GL_R16UI);
+        createBuffer(lightBuffer, lightTexture, GL_RGBA32F);
+    }
+
+    ClusteredLights(const ClusteredLights&) = delete;
+    ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+    // points the program's cluster samplers at the units Update() binds the buffers to
+    void SetSamplers(Shader &shader) const
+    {
+        shader.use();
+        shader.setInt("clusterGrid", GRID_UNIT);
+        shader.setInt("clusterLightIndices", INDEX_UNIT);
+        shader.setInt("clusterLights", LIGHT_UNIT);
+    }
+
+    // replaces the point lights; their radii are worked out here from the attenuation, not every frame. Only the
+    // first MAX_POINT_LIGHTS are kept.
+    void SetPointLights(const vector<rg::PointLightBlock> &pointLights)
+    {
+        lights = pointLights;
+        if (lights.size() > MAX_POINT_LIGHTS)
+        {
+            cout << "ERROR::CLUSTERED_LIGHTS:: " << lights.size() << " point lights, only the first " << MAX_POINT_LIGHTS << " are used" << endl;
+            lights.resize(MAX_POINT_LIGHTS);
+        }
+        for (rg::PointLightBlock &light : lights)
+            light.padding = rg::PointLightRadius(light);
+        upload(lightBuffer, lights.data(), lights.size() * sizeof(rg::PointLightBlock));
+    }
+
+    // Rebuilds the light lists for the camera and binds the buffers; once a frame, after the state cache has
+    // been invalidated. The projection has to be a GL perspective projection.
+    void Update(const glm::mat4 &view, const glm::mat4 &projection)
+    {
+        float near = projection[3][2] / (projection[2][2] - 1.0f);
+        float far = projection[3][2] / (projection[2][2] + 1.0f);
+        rg::ClustersBlock block;
+        block.tileScale = glm::vec2((float)rg::CLUSTERS_X / width, (float)rg::CLUSTERS_Y / height);
+        block.sliceScale = rg::CLUSTERS_Z / std::log(far / near);
+        block.sliceBias = -block.sliceScale * std::log(near);
+        clustersBuffer.Upload(block);
+
+        // the froxels every light touches, then the length of every list, then the lists themselves
+        ranges.clear();
+        for (Cluster &cluster : grid)
+            cluster.count = 0;
+        for (unsigned int i = 0; i < lights.size(); i++)
+        {
+            Range range;
+            if (!lightRange(lights[i], view, projection, near, far, block, range))
+                continue;
+            range.light = i;
+            ranges.push_back(range);
+            forEachCluster(range, [&](Cluster &cluster) { cluster.count++; });
+        }
+        uint32_t offset = 0;
+        for (Cluster &cluster : grid)
+        {
+            cluster.offset = offset;
+            offset += cluster.count;
+            cluster.count = 0;
+        }
+        indices.resize(offset);
+        for (const Range &range : ranges)
+            forEachCluster(range, [&](Cluster &cluster) { indices[cluster.offset + cluster.count++] = (uint16_t)range.light; });
+
+        upload(gridBuffer, grid.data(), grid.size() * sizeof(Cluster));
+        upload(indexBuffer, indices.data(), indices.size() * sizeof(uint16_t));
+        rg::State().BindTexture(GRID_UNIT, GL_TEXTURE_BUFFER, gridTexture);
+        rg::State().BindTexture(INDEX_UNIT, GL_TEXTURE_BUFFER, indexTexture);
+        rg::State().BindTexture(LIGHT_UNIT, GL_TEXTURE_BUFFER, lightTexture);
+    }
+
+    unsigned int PointLightCount() const
+    {
+        return lights.size();
+    }
+
+private:
+    struct Cluster
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // froxels a light touches, inclusive on both ends
+    struct Range
+    {
+        unsigned int light;
+        int x0, x1, y0, y1, z0, z1;
+    };
+
+    unsigned int width, height;
+    rg::UniformBuffer<rg::ClustersBlock> clustersBuffer;
+    unsigned int gridBuffer = 0, gridTexture = 0;
+    unsigned int indexBuffer = 0, indexTexture = 0;
+    unsigned int lightBuffer = 0, lightTexture = 0;
+    vector<rg::PointLightBlock> lights;
+    vector<Cluster> grid;
+    vector<uint16_t> indices;
+    vector<Range> ranges;
+
+    void createBuffer(unsigned int &buffer, unsigned int &texture, GLenum format)
+    {
+        glGenBuffers(1, &buffer);
+        upload(buffer, nullptr, 0);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        rg::State().Invalidate();
+    }
+
+    // the old storage is orphaned, so the upload doesn't wait for draws of the last frame still reading it;
+    // a texture buffer needs some storage even when there is nothing to put in it
+    void upload(unsigned int buffer, const void *data, size_t size)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(size, 16), size > 0 ? data : nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    template<typename F>
+    void forEachCluster(const Range &range, F f)
+    {
+        for (int z = range.z0; z <= range.z1; z++)
+            for (int y = range.y0; y <= range.y1; y++)
+                for (int x = range.x0; x <= range.x1; x++)
+                    f(grid[(z * rg::CLUSTERS_Y + y) * rg::CLUSTERS_X + x]);
+    }
+
+    static int clampCluster(float value, unsigned int count)
+    {
+        return std::min(std::max((int)std::floor(value), 0), (int)count - 1);
+    }
+
+    // false if the light's sphere is entirely outside of the frustum
+    static bool lightRange(const rg::PointLightBlock &light, const glm::mat4 &view, const glm::mat4 &projection,
+                           float near, float far, const rg::ClustersBlock &block, Range &range)
+    {
+        glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        float radius = light.padding;
+        float depthMin = -center.z - radius, depthMax = -center.z + radius;
+        if (radius <= 0.0f || depthMax < near || depthMin > far)
+            return false;
+        range.z0 = clampCluster(std::log(std::max(depthMin, near)) * block.sliceScale + block.sliceBias, rg::CLUSTERS_Z);
+        range.z1 = clampCluster(std::log(std::min(depthMax, far)) * block.sliceScale + block.sliceBias, rg::CLUSTERS_Z);
+
+        // a sphere reaching behind the near plane can cover any part of the screen
+        if (depthMin <= near)
+        {
+            range.x0 = range.y0 = 0;
+            range.x1 = rg::CLUSTERS_X - 1;
+            range.y1 = rg::CLUSTERS_Y - 1;
+            return true;
+        }
+        // otherwise the projected corners of its view space bounding box enclose it on screen
+        glm::vec2 ndcMin(std::numeric_limits<float>::max()), ndcMax(-std::numeric_limits<float>::max());
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner = center + radius * glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+            glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+            glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+            ndcMin = glm::min(ndcMin, ndc);
+            ndcMax = glm::max(ndcMax, ndc);
+        }
+        if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f)
+            return false;
+        range.x0 = clampCluster((ndcMin.x * 0.5f + 0.5f) * rg::CLUSTERS_X, rg::CLUSTERS_X);
+        range.x1 = clampCluster((ndcMax.x * 0.5f + 0.5f) * rg::CLUSTERS_X, rg::CLUSTERS_X);
+        range.y0 = clampCluster((ndcMin.y * 0.5f + 0.5f) * rg::CLUSTERS_Y, rg::CLUSTERS_Y);
+        range.y1 = clampCluster((ndcMax.y * 0.5f + 0.5f) * rg::CLUSTERS_Y, rg::CLUSTERS_Y);
+        return true;
+    }
+};
+
+#endif
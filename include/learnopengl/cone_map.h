@@ -0,0 +1,133 @@
+#ifndef CONE_MAP_H
+#define CONE_MAP_H
+
+#include <rg/Profiler.h>
+#include <rg/ThreadPool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+using namespace std;
+
+// Cone step maps for relief mapping (resources/shaders/parallax.glsl). For every texel of a depth map (0 at the
+// top of the surface, 1 at the bottom) the map stores the widest cone with its apex on the surface there that
+// opens upwards without taking in any other part of the surface, as the ratio of its radius in texture
+// coordinates to its height in depth. A ray inside the cone can step to the cone's edge without passing
+// through the surface, which lets the shader converge in a few steps instead of marching in fixed layers.
+//
+// Finding the widest cone means looking for the nearest texel above the apex relative to how much higher it is,
+// brute force a search over the whole map per texel. The search instead goes down a pyramid of minimum depths,
+// skipping every block that couldn't narrow the cone found so far, and the rows are split over a thread pool;
+// the result is cached with the other textures (uncompressed, see texture_compression.h), so this runs once per
+// height map.
+
+// widest cone ratio stored; wider cones don't make the steps any longer in practice
+const float CONE_MAP_MAX_RATIO = 1.0f;
+
+// Cone step map of a decoded height image whose first channel is depth. Returns RGB8 pixels: red is the depth,
+// green the square root of the cone ratio over CONE_MAP_MAX_RATIO (more precision for the narrow cones that
+// matter), blue is unused. The buffer is malloc'ed, so it can be freed like a decoded stb_image.
+unsigned char* BuildConeMap(const unsigned char *pixels, int width, int height, int components)
+{
+    RG_PROFILE_ZONE("build cone map");
+    // levels[0] is the depth map, every next level holds the minimum of 2x2 texels of the one below
+    vector<vector<float>> levels(1, vector<float>((size_t)width * height));
+    vector<int> levelWidths(1, width), levelHeights(1, height);
+    for (size_t i = 0; i < (size_t)width * height; i++)
+        levels[0][i] = pixels[i * components] / 255.0f;
+    while (levelWidths.back() > 1 || levelHeights.back() > 1)
+    {
+        const vector<float> &below = levels.back();
+        int belowWidth = levelWidths.back(), belowHeight = levelHeights.back();
+        int levelWidth = (belowWidth + 1) / 2, levelHeight = (belowHeight + 1) / 2;
+        vector<float> level((size_t)levelWidth * levelHeight);
+        for (int y = 0; y < levelHeight; y++)
+        {
+            for (int x = 0; x < levelWidth; x++)
+            {
+                int x0 = x * 2, x1 = std::min(x * 2 + 1, belowWidth - 1);
+                int y0 = y * 2, y1 = std::min(y * 2 + 1, belowHeight - 1);
+                level[(size_t)y * levelWidth + x] = std::min(std::min(below[(size_t)y0 * belowWidth + x0], below[(size_t)y0 * belowWidth + x1]),
+                                                             std::min(below[(size_t)y1 * belowWidth + x0], below[(size_t)y1 * belowWidth + x1]));
+            }
+        }
+        levels.push_back(std::move(level));
+        levelWidths.push_back(levelWidth);
+        levelHeights.push_back(levelHeight);
+    }
+    const int top = levels.size() - 1;
+
+    unsigned char *cones = (unsigned char*)malloc((size_t)width * height * 3);
+    auto buildRows = [&](int rowBegin, int rowEnd)
+    {
+        struct Block { int level, x, y; float bound; };
+        vector<Block> stack;
+        for (int py = rowBegin; py < rowEnd; py++)
+        {
+            for (int px = 0; px < width; px++)
+            {
+                float depth = levels[0][(size_t)py * width + px];
+                float best = CONE_MAP_MAX_RATIO;
+                // lower bound of the cone ratio any texel of the block can give, or a value >= best if none can narrow it
+                auto blockBound = [&](int level, int bx, int by)
+                {
+                    float minimum = levels[level][(size_t)by * levelWidths[level] + bx];
+                    if (minimum >= depth)
+                        return best;
+                    int x0 = bx << level, x1 = std::min(((bx + 1) << level) - 1, width - 1);
+                    int y0 = by << level, y1 = std::min(((by + 1) << level) - 1, height - 1);
+                    float dx = std::max(std::max(x0 - px, px - x1), 0) / (float)width;
+                    float dy = std::max(std::max(y0 - py, py - y1), 0) / (float)height;
+                    return std::sqrt(dx * dx + dy * dy) / (depth - minimum);
+                };
+
+                stack.clear();
+                stack.push_back(Block{top, 0, 0, blockBound(top, 0, 0)});
+                while (!stack.empty())
+                {
+                    Block block = stack.back();
+                    stack.pop_back();
+                    if (block.bound >= best)
+                        continue;
+                    if (block.level == 0)
+                    {
+                        best = block.bound;
+                        continue;
+                    }
+                    // children go on the stack farthest first, so the nearest, most likely to narrow the cone, are
+                    // searched first and prune the rest
+                    int level = block.level - 1;
+                    Block children[4];
+                    int count = 0;
+                    for (int cy = block.y * 2; cy <= std::min(block.y * 2 + 1, levelHeights[level] - 1); cy++)
+                        for (int cx = block.x * 2; cx <= std::min(block.x * 2 + 1, levelWidths[level] - 1); cx++)
+                            children[count++] = Block{level, cx, cy, blockBound(level, cx, cy)};
+                    std::sort(children, children + count, [](const Block &a, const Block &b) { return a.bound > b.bound; });
+                    for (int i = 0; i < count; i++)
+                        if (children[i].bound < best)
+                            stack.push_back(children[i]);
+                }
+
+                unsigned char *cone = cones + ((size_t)py * width + px) * 3;
+                cone[0] = pixels[((size_t)py * width + px) * components];
+                cone[1] = (unsigned char)std::floor(std::sqrt(best / CONE_MAP_MAX_RATIO) * 255.0f); // rounded down, narrower is safe
+                cone[2] = 0;
+            }
+        }
+    };
+
+    {
+        rg::ThreadPool pool;
+        const int rowsPerTask = 16;
+        for (int row = 0; row < height; row += rowsPerTask)
+        {
+            int rowEnd = std::min(row + rowsPerTask, height);
+            pool.Submit([&buildRows, row, rowEnd]() { buildRows(row, rowEnd); });
+        }
+        // the pool finishes the queued rows before it is destroyed
+    }
+    return cones;
+}
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/resources.h>
+#include <learnopengl/shader.h>
+#include <rg/GLState.h>
+#include <rg/UniformBuffer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Deferred shading, for scenes with more point lights than the forward shaders' uniform block holds. Opaque
+// geometry is drawn once into a G-buffer (layout in resources/shaders/gbuffer.glsl); Light() then shades it
+// into an HDR target with a full-screen pass for the directional light and one instanced sphere per point
+// light, so every light only costs the pixels its volume covers. The output goes into the same two attachments
+// (color, bright) the forward path writes, so bloom and tone mapping don't need to know which path ran.
+class DeferredRenderer
+{
+public:
+    DeferredRenderer(unsigned int width, unsigned int height)
+        : width(width), height(height),
+          directionalShader(AcquireShader("resources/shaders/bloom_mip.vs", "resources/shaders/deferred_directional.fs")),
+          pointShader(AcquireShader("resources/shaders/deferred_point.vs", "resources/shaders/deferred_point.fs"))
+    {
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        albedoSpec = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        normalShininess = createTarget(GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV);
+        depth = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpec, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalShininess, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::DEFERRED:: G-buffer not complete" << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // the full screen triangle is generated from gl_VertexID, but core profile still wants a VAO bound
+        glGenVertexArrays(1, &fullScreenVAO);
+        createVolume();
+
+        Shader *lightingShaders[] = { &directionalShader, &pointShader };
+        for (Shader *shader : lightingShaders)
+        {
+            shader->use();
+            shader->setInt("gAlbedoSpec", 0);
+            shader->setInt("gNormalShininess", 1);
+            shader->setInt("gDepth", 2);
+        }
+        directionalInverseViewProjection = directionalShader.uniform<glm::mat4>("inverseViewProjection");
+        directionalBlinnPhong = directionalShader.uniform<bool>("blinnPhong");
+        pointInverseViewProjection = pointShader.uniform<glm::mat4>("inverseViewProjection");
+        pointBlinnPhong = pointShader.uniform<bool>("blinnPhong");
+        rg::State().Invalidate();
+    }
+
+    // binds and clears the G-buffer; whatever is drawn until Light() has to write the layout of gbuffer.glsl
+    void BeginGeometry()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // replaces the point lights; their volumes are sized here from the attenuation, not every frame
+    void SetPointLights(const vector<rg::PointLightBlock> &lights)
+    {
+        vector<rg::PointLightBlock> instances(lights);
+        for (rg::PointLightBlock &light : instances)
+            light.padding = rg::PointLightRadius(light);
+        glBindBuffer(GL_ARRAY_BUFFER, lightVBO);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(rg::PointLightBlock), instances.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        lightCount = instances.size();
+    }
+
+    unsigned int PointLightCount() const
+    {
+        return lightCount;
+    }
+
+    // Shades the G-buffer into target, whose depth attachment has to be GL_DEPTH_COMPONENT24 at the G-buffer's
+    // size. The G-buffer depth is copied there first, so passes drawn into target afterwards (sky, transparent
+    // geometry) are depth tested against the opaque scene. Leaves target bound.
+    void Light(unsigned int target, const glm::mat4 &viewProjection, bool blinnPhong)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+
+        glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+        rg::State().BindTexture(0, GL_TEXTURE_2D, albedoSpec);
+        rg::State().BindTexture(1, GL_TEXTURE_2D, normalShininess);
+        rg::State().BindTexture(2, GL_TEXTURE_2D, depth);
+        glDepthMask(GL_FALSE);
+
+        // directional light everywhere something was drawn; this also overwrites what target held before
+        glDisable(GL_DEPTH_TEST);
+        directionalShader.use();
+        directionalShader.set(directionalInverseViewProjection, inverseViewProjection);
+        directionalShader.set(directionalBlinnPhong, blinnPhong);
+        rg::State().BindVertexArray(fullScreenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        // point lights, added on top. Only the back faces of a volume that lie behind the visible surface are
+        // drawn, which is right with the camera inside the volume too; depth clamping keeps volumes reaching past
+        // the far plane from losing their back faces.
+        if (lightCount > 0)
+        {
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(GL_GEQUAL);
+            glEnable(GL_DEPTH_CLAMP);
+            glEnable(GL_CULL_FACE);
+            glCullFace(GL_FRONT);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            glBlendEquation(GL_FUNC_ADD);
+            pointShader.use();
+            pointShader.set(pointInverseViewProjection, inverseViewProjection);
+            pointShader.set(pointBlinnPhong, blinnPhong);
+            rg::State().BindVertexArray(volumeVAO);
+            glDrawElementsInstanced(GL_TRIANGLES, volumeIndexCount, GL_UNSIGNED_INT, 0, lightCount);
+            glDisable(GL_BLEND);
+            glCullFace(GL_BACK);
+            glDisable(GL_CULL_FACE);
+            glDisable(GL_DEPTH_CLAMP);
+        }
+
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+private:
+    unsigned int width, height;
+    unsigned int FBO = 0;
+    unsigned int albedoSpec = 0, normalShininess = 0, depth = 0;
+    unsigned int fullScreenVAO = 0;
+    unsigned int volumeVAO = 0, volumeVBO = 0, volumeEBO = 0, volumeIndexCount = 0;
+    unsigned int lightVBO = 0;
+    unsigned int lightCount = 0;
+    Shader directionalShader;
+    Shader pointShader;
+    rg::Uniform<glm::mat4> directionalInverseViewProjection;
+    rg::Uniform<bool> directionalBlinnPhong;
+    rg::Uniform<glm::mat4> pointInverseViewProjection;
+    rg::Uniform<bool> pointBlinnPhong;
+
+    unsigned int createTarget(GLenum internalFormat, GLenum format, GLenum type)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    // Light volume: an icosahedron subdivided once (80 triangles), scaled out so its faces rather than its
+    // corners enclose the unit sphere. Per-instance attributes 1-4 are the PointLightBlock of the light.
+    void createVolume()
+    {
+        const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+        vector<glm::vec3> vertices = {
+                {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+                {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+                {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}
+        };
+        vector<unsigned int> icosahedron = {
+                0, 11, 5,  0, 5, 1,  0, 1, 7,  0, 7, 10,  0, 10, 11,
+                1, 5, 9,  5, 11, 4,  11, 10, 2,  10, 7, 6,  7, 1, 8,
+                3, 9, 4,  3, 4, 2,  3, 2, 6,  3, 6, 8,  3, 8, 9,
+                4, 9, 5,  2, 4, 11,  6, 2, 10,  8, 6, 7,  9, 8, 1
+        };
+        for (glm::vec3 &vertex : vertices)
+            vertex = glm::normalize(vertex);
+
+        // split every triangle in four, sharing the new vertex of an edge between its two triangles
+        map<pair<unsigned int, unsigned int>, unsigned int> midpoints;
+        auto midpoint = [&](unsigned int a, unsigned int b)
+        {
+            pair<unsigned int, unsigned int> edge(std::min(a, b), std::max(a, b));
+            auto found = midpoints.find(edge);
+            if (found != midpoints.end())
+                return found->second;
+            vertices.push_back(glm::normalize(vertices[a] + vertices[b]));
+            midpoints[edge] = vertices.size() - 1;
+            return (unsigned int)vertices.size() - 1;
+        };
+        vector<unsigned int> indices;
+        for (unsigned int i = 0; i < icosahedron.size(); i += 3)
+        {
+            unsigned int a = icosahedron[i], b = icosahedron[i + 1], c = icosahedron[i + 2];
+            unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            unsigned int triangles[] = { a, ab, ca,  b, bc, ab,  c, ca, bc,  ab, bc, ca };
+            indices.insert(indices.end(), triangles, triangles + 12);
+        }
+
+        float inradius = 1.0f;
+        for (unsigned int i = 0; i < indices.size(); i += 3)
+        {
+            glm::vec3 a = vertices[indices[i]], b = vertices[indices[i + 1]], c = vertices[indices[i + 2]];
+            inradius = std::min(inradius, std::abs(glm::dot(glm::normalize(glm::cross(b - a, c - a)), a)));
+        }
+        for (glm::vec3 &vertex : vertices)
+            vertex /= inradius;
+        volumeIndexCount = indices.size();
+
+        glGenVertexArrays(1, &volumeVAO);
+        glGenBuffers(1, &volumeVBO);
+        glGenBuffers(1, &volumeEBO);
+        glGenBuffers(1, &lightVBO);
+        rg::State().BindVertexArray(volumeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, volumeVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, volumeEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, lightVBO);
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(1 + i);
+            glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(rg::PointLightBlock), (void*)(i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(1 + i, 1);
+        }
+        rg::State().BindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+#endif
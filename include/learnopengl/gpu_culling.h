@@ -0,0 +1,395 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/indirect.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_c.h>
+#include <rg/Frustum.h>
+#include <rg/GLState.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+// GL 4.2/4.3 tokens; the loader only has GL 3.3 core
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+
+// Fields of instances culled by a compute pass instead of CulledInstances on the CPU. The transforms of every
+// field are uploaded once, when it is added; each frame Cull() only resets the draw commands (one per mesh, not
+// per instance, with their ranges looked up in the geometry pool again) and dispatches resources/shaders/cull_instances.cs, which tests every instance against the
+// frustum and optionally against a Hi-Z pyramid, and appends the survivors' instance records and counts with
+// atomics. Draw() submits the commands with glMultiDrawElementsIndirect, one call per material, like
+// IndirectRenderer, so the CPU cost doesn't grow with the number of instances at all.
+//
+// The pyramid is built by BuildHiZ() from the depth of the opaque scene after it is drawn, and tested by the next
+// frame's Cull() with the view-projection it was drawn with. Anything newly uncovered by a camera move shows up a
+// frame late; that is the price of not drawing the scene twice.
+//
+// Needs GL 4.3 (compute shaders, storage buffers, multi-draw indirect); without it Supported() is false and the
+// fields are left to CulledInstances.
+class GpuCulling
+{
+public:
+    // width and height are those of the depth buffers BuildHiZ() reads
+    GpuCulling(GLADloadproc load, unsigned int width, unsigned int height) : width(width), height(height)
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major < 4 || (major == 4 && minor < 3))
+            return;
+        dispatchCompute = (DispatchComputeProc)load("glDispatchCompute");
+        memoryBarrier = (MemoryBarrierProc)load("glMemoryBarrier");
+        bindImageTexture = (BindImageTextureProc)load("glBindImageTexture");
+        multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect");
+        if (dispatchCompute == nullptr || memoryBarrier == nullptr || bindImageTexture == nullptr || multiDrawElementsIndirect == nullptr)
+            return;
+
+        cullShader = new ComputeShader("resources/shaders/cull_instances.cs");
+        reduceShader = new ComputeShader("resources/shaders/hiz_reduce.cs");
+        cullShader->use();
+        cullShader->setInt("hiZ", 0);
+        reduceShader->use();
+        reduceShader->setInt("source", 0);
+        glGenBuffers(1, &transformBuffer);
+        glGenBuffers(1, &commandBuffer);
+        glGenBuffers(1, &recordBuffer);
+        glGenBuffers(1, &meshBuffer);
+        createHiZ();
+    }
+
+    GpuCulling(const GpuCulling&) = delete;
+    GpuCulling& operator=(const GpuCulling&) = delete;
+
+    ~GpuCulling()
+    {
+        if (!Supported())
+            return;
+        delete cullShader;
+        delete reduceShader;
+        glDeleteBuffers(1, &transformBuffer);
+        glDeleteBuffers(1, &commandBuffer);
+        glDeleteBuffers(1, &recordBuffer);
+        glDeleteBuffers(1, &meshBuffer);
+        glDeleteFramebuffers(1, &depthFBO);
+        glDeleteTextures(1, &depthTexture);
+        glDeleteTextures(1, &hiZTexture);
+        rg::State().Invalidate();
+    }
+
+    bool Supported() const
+    {
+        return cullShader != nullptr;
+    }
+
+    // copies of the model culled on the GPU from now on; returns the index of the field
+    unsigned int AddField(Model &model, const vector<glm::mat4> &transforms)
+    {
+        fields.push_back(Field{&model, model.Bounds(), transforms, 0, 0});
+        rebuild();
+        return fields.size() - 1;
+    }
+
+    // replaces the copies of a field, e.g. when the gate changes which fence pieces stand
+    void SetField(unsigned int field, const vector<glm::mat4> &transforms)
+    {
+        fields[field].transforms = transforms;
+        rebuild();
+    }
+
+    // Resets the instance counts and culls every field against the frustum of viewProjection, and against the
+    // last pyramid BuildHiZ() made when occlusion is set. The pyramid is used once; a frame that didn't build
+    // one culls against the frustum only.
+    void Cull(const glm::mat4 &viewProjection, bool occlusion)
+    {
+        if (!Supported() || commands.empty())
+            return;
+        // freeing any mesh can compact the geometry pool, so the ranges are looked up again like at draw time
+        for (unsigned int i = 0; i < commands.size(); i++)
+        {
+            const rg::GeometryRange &range = MeshGeometry().pool.Range(commandMeshes[i]->allocation);
+            commands[i].firstIndex = range.indexOffset / IndexSize(commandMeshes[i]->indexType);
+            commands[i].baseVertex = range.baseVertex;
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, commands.size() * sizeof(IndirectRenderer::DrawElementsIndirectCommand), commands.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, transformBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, recordBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, meshBuffer);
+
+        cullShader->use();
+        rg::Frustum frustum(viewProjection);
+        for (int i = 0; i < rg::Frustum::PLANE_COUNT; i++)
+            cullShader->setVec4("planes[" + to_string(i) + "]", frustum.Plane(i));
+        bool testOcclusion = occlusion && hiZValid;
+        cullShader->setBool("occlusion", testOcclusion);
+        if (testOcclusion)
+        {
+            rg::State().BindTexture(0, GL_TEXTURE_2D, hiZTexture);
+            cullShader->setInt("hiZLevels", hiZLevels);
+            cullShader->setVec2("depthSize", glm::vec2(width, height));
+            cullShader->setMat4("hiZViewProjection", hiZViewProjection);
+        }
+        for (const Field &field : fields)
+        {
+            if (field.transforms.empty())
+                continue;
+            cullShader->setInt("firstTransform", field.firstTransform);
+            cullShader->setInt("instanceCount", field.transforms.size());
+            cullShader->setInt("firstMesh", field.firstMesh);
+            cullShader->setInt("meshCount", field.model->meshes.size());
+            cullShader->setVec4("sphere", glm::vec4(field.bounds.center, field.bounds.radius));
+            dispatchCompute((field.transforms.size() + 63) / 64, 1, 1);
+        }
+        hiZValid = false;
+        // the draws read the counts as commands and the records as vertex attributes
+        memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+
+    // Draws what the last Cull() kept with the program, whose "instanced" and "indirect" uniforms have to be set.
+    // Can be called any number of times per frame, like IndirectRenderer::Draw().
+    void Draw(Shader &shader)
+    {
+        if (!Supported() || commands.empty())
+            return;
+        rg::State().BindVertexArray(MeshGeometry().pool.VertexArray());
+        IndirectRenderer::PointInstanceAttributes(recordBuffer, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        for (const Batch &batch : batches)
+        {
+            batch.material->BindTextures(shader);
+            multiDrawElementsIndirect(GL_TRIANGLES, batch.material->indexType,
+                                      (void*)(batch.firstCommand * sizeof(IndirectRenderer::DrawElementsIndirectCommand)),
+                                      batch.commandCount, 0);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        IndirectRenderer::ReleaseInstanceAttributes();
+    }
+
+    // Builds the Hi-Z pyramid for the next Cull() from the depth attachment of framebuffer, which has to be
+    // GL_DEPTH_COMPONENT24 at the size given to the constructor and hold the opaque scene drawn with
+    // viewProjection. Leaves framebuffer bound.
+    void BuildHiZ(unsigned int framebuffer, const glm::mat4 &viewProjection)
+    {
+        if (!Supported())
+            return;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFBO);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        reduceShader->use();
+        for (int level = 0; level < hiZLevels; level++)
+        {
+            // level 0 reduces the depth buffer itself, every other level the one above it
+            rg::State().BindTexture(0, GL_TEXTURE_2D, level == 0 ? depthTexture : hiZTexture);
+            reduceShader->setInt("sourceLevel", level == 0 ? 0 : level - 1);
+            bindImageTexture(0, hiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            unsigned int levelWidth = std::max(1u, (width / 2) >> level);
+            unsigned int levelHeight = std::max(1u, (height / 2) >> level);
+            dispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+            memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+        hiZViewProjection = viewProjection;
+        hiZValid = true;
+    }
+
+    // instances tested by every Cull()
+    unsigned int InstanceCount() const
+    {
+        return instanceCount;
+    }
+
+    // the calls a Draw() takes
+    unsigned int CallCount() const
+    {
+        return batches.size();
+    }
+
+private:
+    typedef void (APIENTRY *DispatchComputeProc)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+    typedef void (APIENTRY *MemoryBarrierProc)(GLbitfield barriers);
+    typedef void (APIENTRY *BindImageTextureProc)(GLuint unit, GLuint texture, GLint level, GLboolean layered,
+                                                  GLint layer, GLenum access, GLenum format);
+    typedef void (APIENTRY *MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect,
+                                                           GLsizei drawCount, GLsizei stride);
+
+    struct Field {
+        Model *model;
+        rg::Bounds bounds;
+        vector<glm::mat4> transforms;
+        // where rebuild() put its transforms and meshes
+        unsigned int firstTransform;
+        unsigned int firstMesh;
+    };
+
+    // the CulledMesh of cull_instances.cs, std430
+    struct CulledMesh {
+        glm::vec4 boundsMin;
+        glm::vec4 boundsExtent;
+        uint32_t command;
+        uint32_t pad[3];
+    };
+
+    // commands that share textures and index type; material is the first mesh among them
+    struct Batch {
+        Mesh *material;
+        unsigned int firstCommand;
+        unsigned int commandCount;
+    };
+
+    DispatchComputeProc dispatchCompute = nullptr;
+    MemoryBarrierProc memoryBarrier = nullptr;
+    BindImageTextureProc bindImageTexture = nullptr;
+    MultiDrawElementsIndirectProc multiDrawElementsIndirect = nullptr;
+    ComputeShader *cullShader = nullptr;
+    ComputeShader *reduceShader = nullptr;
+
+    unsigned int transformBuffer = 0, commandBuffer = 0, recordBuffer = 0, meshBuffer = 0;
+    vector<Field> fields;
+    // the commands with their instance counts at zero, copied over the GPU's before every Cull()
+    vector<IndirectRenderer::DrawElementsIndirectCommand> commands;
+    // the mesh each command draws
+    vector<Mesh*> commandMeshes;
+    vector<Batch> batches;
+    unsigned int instanceCount = 0;
+
+    unsigned int width, height;
+    unsigned int depthFBO = 0, depthTexture = 0, hiZTexture = 0;
+    int hiZLevels = 0;
+    bool hiZValid = false;
+    glm::mat4 hiZViewProjection = glm::mat4(1.0f);
+
+    // Lays the fields out again after one is added or changed: transforms one after another, and for every mesh
+    // of every field a command, sorted into material batches, whose records take room for all the field's
+    // instances.
+    void rebuild()
+    {
+        if (!Supported())
+            return;
+        struct Slot {
+            Mesh *mesh;
+            unsigned int field;
+            unsigned int meshIndex;
+        };
+        vector<glm::mat4> transforms;
+        vector<Slot> slots;
+        for (unsigned int f = 0; f < fields.size(); f++)
+        {
+            Field &field = fields[f];
+            field.firstTransform = transforms.size();
+            transforms.insert(transforms.end(), field.transforms.begin(), field.transforms.end());
+            for (unsigned int m = 0; m < field.model->meshes.size(); m++)
+                slots.push_back(Slot{&field.model->meshes[m], f, m});
+        }
+        instanceCount = transforms.size();
+        std::stable_sort(slots.begin(), slots.end(), [](const Slot &a, const Slot &b)
+        {
+            return IndirectRenderer::MaterialBefore(*a.mesh, *b.mesh);
+        });
+
+        // the meshes of a field stay next to each other in the mesh buffer, in the model's order
+        vector<CulledMesh> meshes;
+        for (Field &field : fields)
+        {
+            field.firstMesh = meshes.size();
+            meshes.resize(meshes.size() + field.model->meshes.size());
+        }
+        commands.clear();
+        commandMeshes.clear();
+        batches.clear();
+        unsigned int records = 0;
+        for (const Slot &slot : slots)
+        {
+            const Field &field = fields[slot.field];
+            const rg::GeometryRange &range = MeshGeometry().pool.Range(slot.mesh->allocation);
+            IndirectRenderer::DrawElementsIndirectCommand command;
+            command.count = slot.mesh->indexCount;
+            command.instanceCount = 0;
+            command.firstIndex = range.indexOffset / IndexSize(slot.mesh->indexType);
+            command.baseVertex = range.baseVertex;
+            command.baseInstance = records;
+            records += field.transforms.size();
+
+            CulledMesh &mesh = meshes[field.firstMesh + slot.meshIndex];
+            mesh.boundsMin = glm::vec4(slot.mesh->bounds.min, 0.0f);
+            mesh.boundsExtent = glm::vec4(slot.mesh->bounds.max - slot.mesh->bounds.min, 0.0f);
+            mesh.command = commands.size();
+
+            if (batches.empty() || !IndirectRenderer::SameMaterial(*batches.back().material, *slot.mesh))
+                batches.push_back(Batch{slot.mesh, (unsigned int)commands.size(), 0});
+            batches.back().commandCount++;
+            commands.push_back(command);
+            commandMeshes.push_back(slot.mesh);
+        }
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, transformBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, transforms.size() * sizeof(glm::mat4), transforms.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(IndirectRenderer::DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, recordBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)records * sizeof(IndirectRenderer::InstanceRecord), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, meshes.size() * sizeof(CulledMesh), meshes.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // a depth texture to copy the scene's depth into, and the R32F pyramid from half its size down to 1x1
+    void createHiZ()
+    {
+        glGenTextures(1, &depthTexture);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenFramebuffers(1, &depthFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::GPU_CULLING:: Hi-Z depth framebuffer not complete" << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        unsigned int levelWidth = std::max(1u, width / 2), levelHeight = std::max(1u, height / 2);
+        glGenTextures(1, &hiZTexture);
+        glBindTexture(GL_TEXTURE_2D, hiZTexture);
+        for (hiZLevels = 0; ; hiZLevels++)
+        {
+            glTexImage2D(GL_TEXTURE_2D, hiZLevels, GL_R32F, levelWidth, levelHeight, 0, GL_RED, GL_FLOAT, NULL);
+            if (levelWidth == 1 && levelHeight == 1)
+                break;
+            levelWidth = std::max(1u, levelWidth / 2);
+            levelHeight = std::max(1u, levelHeight / 2);
+        }
+        hiZLevels++;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, hiZLevels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        rg::State().Invalidate();
+    }
+};
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef INDIRECT_H
+#define INDIRECT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/Frustum.h>
+#include <rg/GLState.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+// GL 4.0/4.3 tokens; the loader only has GL 3.3 core
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// Opaque models submitted as lists of draw commands instead of one call per mesh. Every frame the models and
+// their visible transforms are added, and Upload() turns them into one DrawElementsIndirectCommand per mesh and
+// one instance record per drawn copy, in two buffer uploads. Draw() then binds each distinct set of material
+// textures once and submits all meshes using it with a single glMultiDrawElementsIndirect, so the calls per pass
+// follow the number of materials, not of meshes or objects.
+//
+// The shaders are GL 3.3, without storage buffers or gl_DrawID, so the per-draw data (model matrix and the bounds
+// the mesh's positions are packed in) comes in as instanced attributes: each command's baseInstance points at its
+// own instance records. Without GL 4.3 or ARB_multi_draw_indirect with ARB_base_instance the same commands are
+// drawn in a loop that moves the instance attributes to each command's records.
+class IndirectRenderer
+{
+public:
+    // the layout of the command glMultiDrawElementsIndirect reads
+    struct DrawElementsIndirectCommand {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        uint32_t baseVertex;
+        uint32_t baseInstance;
+    };
+
+    // per drawn copy of a mesh, fed to attributes 5-10 (packed_vertex.glsl, 2.model_lighting.vs)
+    struct InstanceRecord {
+        glm::mat4 model;
+        glm::vec4 boundsMin;    // xyz
+        glm::vec4 boundsExtent; // xyz
+    };
+
+    // detects multi-draw indirect support and loads its entry point through the GL loader
+    explicit IndirectRenderer(GLADloadproc load)
+    {
+        GLint major = 0, minor = 0, extensionCount = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        bool supported = major > 4 || (major == 4 && minor >= 3);
+        bool multiDrawExtension = false, baseInstanceExtension = false;
+        for (GLint i = 0; i < extensionCount; i++)
+        {
+            const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            multiDrawExtension = multiDrawExtension || strcmp(extension, "GL_ARB_multi_draw_indirect") == 0;
+            baseInstanceExtension = baseInstanceExtension || strcmp(extension, "GL_ARB_base_instance") == 0;
+        }
+        if (supported || (multiDrawExtension && baseInstanceExtension))
+            multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect");
+
+        glGenBuffers(1, &instanceBuffer);
+        if (multiDrawElementsIndirect != nullptr)
+            glGenBuffers(1, &commandBuffer);
+    }
+
+    IndirectRenderer(const IndirectRenderer&) = delete;
+    IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+
+    ~IndirectRenderer()
+    {
+        glDeleteBuffers(1, &instanceBuffer);
+        if (commandBuffer != 0)
+            glDeleteBuffers(1, &commandBuffer);
+    }
+
+    // false when the commands are drawn one by one
+    bool MultiDrawSupported() const
+    {
+        return multiDrawElementsIndirect != nullptr;
+    }
+
+    // forgets the models added for the last frame
+    void Begin()
+    {
+        draws.clear();
+        records.clear();
+    }
+
+    // one copy of the model; its meshes are culled against the frustum one by one, as Model::Draw does
+    void Add(Model &model, const glm::mat4 &transform, const rg::Frustum &frustum)
+    {
+        for (Mesh &mesh : model.meshes)
+            if (frustum.Intersects(rg::TransformSphere(mesh.bounds, transform)))
+                add(mesh, &transform, 1);
+    }
+
+    // copies of the model that have already been culled, e.g. CulledInstances::VisibleTransforms()
+    void Add(Model &model, const vector<glm::mat4> &transforms)
+    {
+        if (transforms.empty())
+            return;
+        for (Mesh &mesh : model.meshes)
+            add(mesh, transforms.data(), transforms.size());
+    }
+
+    // builds and uploads the commands and instance records of everything added since Begin()
+    void Upload()
+    {
+        // meshes with the same textures and index type end up next to each other and go in one call
+        std::stable_sort(draws.begin(), draws.end(), [](const PendingDraw &a, const PendingDraw &b)
+        {
+            return MaterialBefore(*a.mesh, *b.mesh);
+        });
+        commands.clear();
+        batches.clear();
+        for (const PendingDraw &draw : draws)
+        {
+            const rg::GeometryRange &range = MeshGeometry().pool.Range(draw.mesh->allocation);
+            DrawElementsIndirectCommand command;
+            command.count = draw.mesh->indexCount;
+            command.instanceCount = draw.instanceCount;
+            command.firstIndex = range.indexOffset / IndexSize(draw.mesh->indexType);
+            command.baseVertex = range.baseVertex;
+            command.baseInstance = draw.firstRecord;
+            if (batches.empty() || !SameMaterial(*batches.back().material, *draw.mesh))
+                batches.push_back(Batch{draw.mesh, (unsigned int)commands.size(), 0});
+            batches.back().commandCount++;
+            commands.push_back(command);
+        }
+
+        // orphaned, so the upload doesn't wait for the last frame's draws still reading the buffers
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, records.size() * sizeof(InstanceRecord), records.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (commandBuffer != 0)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+    }
+
+    // Draws the uploaded commands with the program, whose "instanced" and "indirect" uniforms have to be set. Can
+    // be called any number of times per frame, e.g. by the depth pre-pass and then by the pass shading the models.
+    void Draw(Shader &shader)
+    {
+        if (commands.empty())
+            return;
+        rg::State().BindVertexArray(MeshGeometry().pool.VertexArray());
+        PointInstanceAttributes(instanceBuffer, 0);
+        if (multiDrawElementsIndirect != nullptr)
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        for (const Batch &batch : batches)
+        {
+            batch.material->BindTextures(shader);
+            GLenum indexType = batch.material->indexType;
+            if (multiDrawElementsIndirect != nullptr)
+            {
+                multiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)(batch.firstCommand * sizeof(DrawElementsIndirectCommand)),
+                                          batch.commandCount, 0);
+                continue;
+            }
+            for (unsigned int i = batch.firstCommand; i < batch.firstCommand + batch.commandCount; i++)
+            {
+                const DrawElementsIndirectCommand &command = commands[i];
+                PointInstanceAttributes(instanceBuffer, command.baseInstance);
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, indexType,
+                                                  (void*)((size_t)command.firstIndex * IndexSize(indexType)),
+                                                  command.instanceCount, command.baseVertex);
+            }
+        }
+        if (multiDrawElementsIndirect != nullptr)
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        ReleaseInstanceAttributes();
+    }
+
+    // commands submitted by the last Upload(), and the calls they take
+    unsigned int CommandCount() const
+    {
+        return commands.size();
+    }
+
+    unsigned int CallCount() const
+    {
+        return multiDrawElementsIndirect != nullptr ? batches.size() : commands.size();
+    }
+
+    // the order meshes are batched in: by index type, then by the ids of their textures, like strings
+    static bool MaterialBefore(const Mesh &a, const Mesh &b)
+    {
+        if (a.indexType != b.indexType)
+            return a.indexType < b.indexType;
+        return compareTextures(a, b) < 0;
+    }
+
+    // meshes that can go in one call
+    static bool SameMaterial(const Mesh &a, const Mesh &b)
+    {
+        return a.indexType == b.indexType && compareTextures(a, b) == 0;
+    }
+
+    // points attributes 5-10 at the InstanceRecords in buffer, starting with the given one; expects the pool's
+    // VAO bound
+    static void PointInstanceAttributes(unsigned int buffer, unsigned int firstRecord)
+    {
+        size_t base = (size_t)firstRecord * sizeof(InstanceRecord);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        // the model matrix, one vec4 column per location, then the bounds
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            glEnableVertexAttribArray(5 + i);
+            glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceRecord), (void*)(base + i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + i, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // the pool's VAO is shared with Mesh, which attaches its own instance buffers; leaves it without any
+    static void ReleaseInstanceAttributes()
+    {
+        for (unsigned int i = 5; i <= 10; i++)
+            glDisableVertexAttribArray(i);
+        MeshGeometry().instanceVBO = 0;
+    }
+
+private:
+    typedef void (APIENTRY *MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect,
+                                                           GLsizei drawCount, GLsizei stride);
+
+    struct PendingDraw {
+        Mesh *mesh;
+        unsigned int firstRecord;
+        unsigned int instanceCount;
+    };
+
+    // commands that share textures and index type; material is the first mesh among them
+    struct Batch {
+        Mesh *material;
+        unsigned int firstCommand;
+        unsigned int commandCount;
+    };
+
+    MultiDrawElementsIndirectProc multiDrawElementsIndirect = nullptr;
+    unsigned int instanceBuffer = 0, commandBuffer = 0;
+    vector<PendingDraw> draws;
+    vector<InstanceRecord> records;
+    vector<DrawElementsIndirectCommand> commands;
+    vector<Batch> batches;
+
+    void add(Mesh &mesh, const glm::mat4 *transforms, unsigned int count)
+    {
+        draws.push_back(PendingDraw{&mesh, (unsigned int)records.size(), count});
+        InstanceRecord record;
+        record.boundsMin = glm::vec4(mesh.bounds.min, 0.0f);
+        record.boundsExtent = glm::vec4(mesh.bounds.max - mesh.bounds.min, 0.0f);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            record.model = transforms[i];
+            records.push_back(record);
+        }
+    }
+
+    static int compareTextures(const Mesh &a, const Mesh &b)
+    {
+        for (unsigned int i = 0; i < a.textures.size() && i < b.textures.size(); i++)
+            if (a.textures[i].id != b.textures[i].id)
+                return a.textures[i].id < b.textures[i].id ? -1 : 1;
+        return (int)a.textures.size() - (int)b.textures.size();
+    }
+};
+
+#endif
@@ -7,7 +7,14 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/Frustum.h>
+#include <rg/GeometryPool.h>
+#include <rg/GLState.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 using namespace std;
@@ -25,6 +32,112 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// Vertex as it is stored in the mesh cache and uploaded, 20 bytes instead of the 56 of Vertex (three vertices
+// to a 64 byte cache line instead of one). Decoded by resources/shaders/packed_vertex.glsl.
+//     Position   unsigned normalized 16 bit, relative to the mesh bounds; w is 1 for a right handed tangent
+//                frame and 0 for a left handed one
+//     Frame      signed normalized 16 bit, the octahedral encoding of the normal in xy and of the tangent in zw;
+//                the bitangent is their cross product times the handedness
+//     TexCoords  half floats
+struct PackedVertex {
+    uint16_t Position[4];
+    int16_t  Frame[4];
+    uint16_t TexCoords[2];
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex has to stay tightly packed");
+
+// float to half float, rounded to nearest even; out of range values become infinity
+uint16_t PackHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFFu) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+    if (((bits >> 23) & 0xFFu) == 0xFFu)
+        return sign | 0x7C00u | (mantissa ? 0x200u : 0u);
+    if (exponent >= 31)
+        return sign | 0x7C00u;
+    if (exponent <= 0)
+    {
+        // subnormal or zero
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000u;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1u)))
+            half++;
+        return sign | half;
+    }
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFFu;
+    // a carry out of the mantissa correctly moves on to the next exponent
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+        half++;
+    return sign | half;
+}
+
+int16_t PackSnorm16(float value)
+{
+    return (int16_t)std::round(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+// octahedral encoding of a unit vector: projected onto the octahedron and its lower half folded over the upper
+glm::vec2 OctahedralEncode(glm::vec3 direction)
+{
+    direction /= std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    glm::vec2 encoded(direction.x, direction.y);
+    if (direction.z < 0.0f)
+    {
+        encoded.x = (1.0f - std::abs(direction.y)) * (direction.x >= 0.0f ? 1.0f : -1.0f);
+        encoded.y = (1.0f - std::abs(direction.x)) * (direction.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return encoded;
+}
+
+// packs a vertex whose position lies within the given bounds
+PackedVertex PackVertex(const Vertex &vertex, const rg::Bounds &bounds)
+{
+    PackedVertex packed;
+    glm::vec3 extent = bounds.max - bounds.min;
+    for (int i = 0; i < 3; i++)
+    {
+        float t = extent[i] > 0.0f ? (vertex.Position[i] - bounds.min[i]) / extent[i] : 0.0f;
+        packed.Position[i] = (uint16_t)std::round(std::min(std::max(t, 0.0f), 1.0f) * 65535.0f);
+    }
+
+    glm::vec3 normal = glm::length(vertex.Normal) > 0.0f ? glm::normalize(vertex.Normal) : glm::vec3(0.0f, 1.0f, 0.0f);
+    // the tangent made orthogonal to the normal; meshes without texture coordinates get any orthogonal one
+    glm::vec3 tangent = vertex.Tangent - normal * glm::dot(normal, vertex.Tangent);
+    if (glm::length(tangent) < 1e-6f)
+        tangent = glm::cross(normal, std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+    tangent = glm::normalize(tangent);
+    packed.Position[3] = glm::dot(glm::cross(normal, tangent), vertex.Bitangent) < 0.0f ? 0 : 65535;
+
+    glm::vec2 encodedNormal = OctahedralEncode(normal);
+    glm::vec2 encodedTangent = OctahedralEncode(tangent);
+    packed.Frame[0] = PackSnorm16(encodedNormal.x);
+    packed.Frame[1] = PackSnorm16(encodedNormal.y);
+    packed.Frame[2] = PackSnorm16(encodedTangent.x);
+    packed.Frame[3] = PackSnorm16(encodedTangent.y);
+
+    packed.TexCoords[0] = PackHalf(vertex.TexCoords.x);
+    packed.TexCoords[1] = PackHalf(vertex.TexCoords.y);
+    return packed;
+}
+
+// the vertices packed relative to their own bounds, which the shader needs to decode them (Mesh::bounds)
+vector<PackedVertex> PackVertices(const Vertex *vertices, unsigned int count, const rg::Bounds &bounds)
+{
+    vector<PackedVertex> packed(count);
+    for (unsigned int i = 0; i < count; i++)
+        packed[i] = PackVertex(vertices[i], bounds);
+    return packed;
+}
+
 
 
 struct Texture {
@@ -33,6 +146,177 @@ struct Texture {
     string path;
 };
 
+// material texture as referenced by an imported mesh, before it is loaded
+struct TextureRef {
+    string type;
+    string path; // relative to the model's directory
+};
+
+// bytes per index of GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+unsigned int IndexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// CPU-side mesh in its final, packed layout, produced by the importer and consumed by the Mesh constructor.
+// The arrays either live in the owned vectors or, when externalVertices/externalIndices are set, in memory
+// owned by someone else (the mapped mesh cache). The importer works on 32 bit indices and NarrowIndices() then
+// moves them to 16 bits if the mesh has few enough vertices, which all of ours do.
+struct MeshData {
+    vector<PackedVertex> vertices;
+    vector<unsigned int> indices;
+    vector<uint16_t>     shortIndices;
+    const PackedVertex  *externalVertices = nullptr;
+    const void          *externalIndices = nullptr;
+    GLenum               externalIndexType = GL_UNSIGNED_INT;
+    unsigned int         externalVertexCount = 0;
+    unsigned int         externalIndexCount = 0;
+    vector<TextureRef>   textures;
+    rg::Bounds           bounds; // of the vertex positions, computed at import; the positions are packed within it
+
+    const PackedVertex* VertexData() const { return externalVertices ? externalVertices : vertices.data(); }
+    unsigned int VertexCount() const { return externalVertices ? externalVertexCount : vertices.size(); }
+    GLenum IndexType() const
+    {
+        if (externalIndices)
+            return externalIndexType;
+        return shortIndices.empty() ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    }
+    const void* IndexData() const
+    {
+        if (externalIndices)
+            return externalIndices;
+        return shortIndices.empty() ? (const void*)indices.data() : (const void*)shortIndices.data();
+    }
+    unsigned int IndexCount() const
+    {
+        if (externalIndices)
+            return externalIndexCount;
+        return shortIndices.empty() ? indices.size() : shortIndices.size();
+    }
+    size_t IndexBytes() const { return (size_t)IndexCount() * IndexSize(IndexType()); }
+
+    void NarrowIndices()
+    {
+        if (VertexCount() > 65536 || indices.empty())
+            return;
+        shortIndices.assign(indices.begin(), indices.end());
+        vector<unsigned int>().swap(indices);
+    }
+};
+
+// per-instance model matrices for instanced draws, fed to vertex attributes 5-8 (one vec4 column each)
+struct InstanceBuffer {
+    unsigned int VBO = 0;
+    unsigned int count = 0;
+
+    // (re)uploads the transforms; pass GL_DYNAMIC_DRAW for buffers that change every frame
+    void Upload(const vector<glm::mat4> &transforms, GLenum usage = GL_STATIC_DRAW)
+    {
+        if (VBO == 0)
+            glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, transforms.size() * sizeof(glm::mat4), transforms.data(), usage);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        count = transforms.size();
+    }
+};
+
+// Instances of one model that are culled against the view frustum before they are drawn. The world-space
+// bounding sphere of every instance is computed once in Set; Cull then keeps only the visible transforms in
+// the instance buffer, uploading them again only when the visible set changed.
+class CulledInstances
+{
+public:
+    InstanceBuffer buffer;
+
+    // the model bounds are those of all its meshes (Model::Bounds), in model space
+    void Set(const vector<glm::mat4> &transforms, const rg::Bounds &modelBounds)
+    {
+        this->transforms = transforms;
+        spheres.Clear();
+        for (const glm::mat4 &transform : transforms)
+            spheres.Add(rg::TransformSphere(modelBounds, transform));
+        uploaded.clear();
+        visibleTransforms = transforms;
+        buffer.Upload(transforms, GL_DYNAMIC_DRAW);
+        uploaded.resize(transforms.size());
+        for (unsigned int i = 0; i < uploaded.size(); i++)
+            uploaded[i] = i;
+    }
+
+    void Cull(const rg::Frustum &frustum)
+    {
+        spheres.Cull(frustum, visible);
+        if (visible == uploaded)
+            return;
+        visibleTransforms.clear();
+        for (uint32_t index : visible)
+            visibleTransforms.push_back(transforms[index]);
+        buffer.Upload(visibleTransforms, GL_DYNAMIC_DRAW);
+        uploaded.swap(visible);
+    }
+
+    unsigned int Total() const
+    {
+        return transforms.size();
+    }
+
+    // every instance, whether it passed the last test or not
+    const vector<glm::mat4>& Transforms() const
+    {
+        return transforms;
+    }
+
+    // the transforms in the instance buffer, those that passed the last test
+    const vector<glm::mat4>& VisibleTransforms() const
+    {
+        return visibleTransforms;
+    }
+
+    unsigned int Visible() const
+    {
+        return buffer.count;
+    }
+
+private:
+    vector<glm::mat4> transforms;
+    rg::SphereSet spheres;
+    // indices of the instances in the buffer, and of those that passed the last test
+    vector<uint32_t> uploaded, visible;
+    vector<glm::mat4> visibleTransforms;
+};
+
+// declares the PackedVertex attributes 0-2 on the bound VAO, reading from the bound array buffer
+void SetupPackedVertexAttributes()
+{
+    // vertex positions and tangent frame handedness
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Position));
+    // normal and tangent
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Frame));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+}
+
+// the geometry pool every mesh is allocated from, and the instance buffer attached to its VAO
+struct MeshGeometryPool {
+    rg::GeometryPool pool{sizeof(PackedVertex), SetupPackedVertexAttributes};
+    // instance buffer currently attached to attributes 5-8 of the pool's VAO
+    unsigned int instanceVBO = 0;
+};
+
+// created with the first mesh, once there is a GL context
+MeshGeometryPool& MeshGeometry()
+{
+    static MeshGeometryPool geometry;
+    return geometry;
+}
+
+// All meshes live in the one geometry pool (rg/GeometryPool.h) and are drawn from its VAO with base vertex draws,
+// so consecutive meshes don't switch vertex arrays.
 class Mesh {
 public:
     // mesh Data
@@ -40,100 +324,199 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
 
-    unsigned int VAO;
-    std::string glslIdentifierPrefix;
+    // handle of the mesh's ranges in MeshGeometry().pool
+    unsigned int allocation;
+    unsigned int indexCount;
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLenum indexType;
+    // also what the vertex positions are packed relative to, so it has to be set before the mesh is drawn
+    rg::Bounds bounds;
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
     {
-        this->vertices = vertices;
-        this->indices = indices;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
         this->textures = textures;
+        this->bounds = rg::Bounds::Of(this->vertices.data(), this->vertices.size());
+        buildSamplerNames();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        MeshData data;
+        data.vertices = PackVertices(this->vertices.data(), this->vertices.size(), bounds);
+        data.indices = this->indices;
+        data.NarrowIndices();
+        allocate(data.VertexData(), data.VertexCount(), data.IndexData(), data.IndexCount(), data.IndexType());
+    }
+
+    // constructor for data that is already in its final layout (e.g. memory-mapped from the mesh cache);
+    // the arrays are uploaded as they are and no CPU-side copy is kept, so vertices and indices stay empty
+    Mesh(const PackedVertex *vertexData, unsigned int vertexCount, const void *indexData, unsigned int indexCount,
+         GLenum indexType, vector<Texture> textures)
+    {
+        this->textures = textures;
+        buildSamplerNames();
+        allocate(vertexData, vertexCount, indexData, indexCount, indexType);
     }
 
-    // render the mesh
+    // constructor for a pool allocation that already holds the mesh (shared through the resource registry); the
+    // allocation stays owned by whoever made it
+    Mesh(unsigned int allocation, unsigned int indexCount, GLenum indexType, vector<Texture> textures)
+    {
+        this->textures = textures;
+        buildSamplerNames();
+        this->allocation = allocation;
+        this->indexCount = indexCount;
+        this->indexType = indexType;
+    }
+
+    // prefix of the sampler names in the shader, e.g. "material."; the names are rebuilt here and not per draw
+    void SetSamplerPrefix(const string &prefix)
+    {
+        glslIdentifierPrefix = prefix;
+        buildSamplerNames();
+    }
+
+    // render the mesh; binds go through the state cache and skip whatever is already bound, and after the first
+    // draw with a program nothing here allocates
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
+        BindTextures(shader);
+        setBounds(shader);
+
+        // draw mesh
+        const rg::GeometryRange &range = MeshGeometry().pool.Range(allocation);
+        rg::State().BindVertexArray(MeshGeometry().pool.VertexArray());
+        // the VAO is shared with the instanced draws, whose buffer may not even hold one instance
+        if (MeshGeometry().instanceVBO != 0)
+            setupInstanceAttributes(0);
+        glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, indexType, (void*)(size_t)range.indexOffset, range.baseVertex);
+    }
+
+    // render instances.count copies of the mesh with a single draw call, taking the model matrix of every
+    // copy from the instance buffer instead of the "model" uniform
+    void DrawInstanced(Shader &shader, const InstanceBuffer &instances)
+    {
+        if (instances.count == 0)
+            return;
+        BindTextures(shader);
+        setBounds(shader);
+
+        const rg::GeometryRange &range = MeshGeometry().pool.Range(allocation);
+        rg::State().BindVertexArray(MeshGeometry().pool.VertexArray());
+        if (MeshGeometry().instanceVBO != instances.VBO)
+            setupInstanceAttributes(instances.VBO);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indexCount, indexType, (void*)(size_t)range.indexOffset,
+                                          instances.count, range.baseVertex);
+    }
+
+    // texture i goes to unit i, and its sampler (if the program has it) is pointed at that unit
+    void BindTextures(Shader &shader)
+    {
+        const SamplerBinding &binding = samplerBinding(shader);
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            rg::State().SetSamplerUnit(shader.ID, binding.locations[i], i);
+            rg::State().BindTexture(i, GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+private:
+    // sampler uniform locations of the textures in one program, in texture order; -1 where the program has no
+    // such sampler. Also holds the program's uniforms for decoding the packed positions.
+    struct SamplerBinding {
+        unsigned int program;
+        vector<GLint> locations;
+        rg::Uniform<glm::vec3> boundsMin;
+        rg::Uniform<glm::vec3> boundsExtent;
+    };
+
+    string glslIdentifierPrefix;
+    // shader name of every texture's sampler (prefix + type + number, e.g. "material.texture_diffuse1")
+    vector<string> samplerNames;
+    // one table per program the mesh has been drawn with; usually one or two, so they are searched linearly
+    vector<SamplerBinding> samplerBindings;
+
+    // names the samplers the way the shaders expect: texture_diffuseN, texture_specularN, texture_normalN and
+    // texture_heightN, counting from 1 per type
+    void buildSamplerNames()
+    {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        samplerNames.clear();
+        for (const Texture &texture : textures)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
-            string name = textures[i].type;
+            const string &name = texture.type;
             if(name == "texture_diffuse")
                 number = std::to_string(diffuseNr++);
             else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
+                number = std::to_string(specularNr++);
             else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
+                number = std::to_string(normalNr++);
             else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+                number = std::to_string(heightNr++);
+            samplerNames.push_back(glslIdentifierPrefix + name + number);
         }
+        samplerBindings.clear();
+    }
 
+    const SamplerBinding& samplerBinding(const Shader &shader)
+    {
+        for (const SamplerBinding &binding : samplerBindings)
+            if (binding.program == shader.ID)
+                return binding;
 
+        SamplerBinding binding;
+        binding.program = shader.ID;
+        for (const string &name : samplerNames)
+            binding.locations.push_back(shader.uniformLocation(name));
+        binding.boundsMin = shader.uniform<glm::vec3>("meshBoundsMin");
+        binding.boundsExtent = shader.uniform<glm::vec3>("meshBoundsExtent");
+        samplerBindings.push_back(binding);
+        return samplerBindings.back();
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // the box the positions are packed in, for packed_vertex.glsl
+    void setBounds(Shader &shader)
+    {
+        const SamplerBinding &binding = samplerBinding(shader);
+        shader.set(binding.boundsMin, bounds.min);
+        shader.set(binding.boundsExtent, bounds.max - bounds.min);
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
-
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // points the per-instance mat4 attribute at the given buffer, or disables it for 0; expects the pool's VAO
+    // to be bound
+    void setupInstanceAttributes(unsigned int buffer)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        MeshGeometry().instanceVBO = buffer;
+        if (buffer == 0)
+        {
+            for (unsigned int i = 0; i < 4; i++)
+                glDisableVertexAttribArray(5 + i);
+            return;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        // a mat4 attribute takes up four consecutive locations, one per column
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(5 + i);
+            glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + i, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+    // copies the mesh into the geometry pool
+    void allocate(const PackedVertex *vertexData, unsigned int vertexCount, const void *indexData, unsigned int indexCount,
+                  GLenum indexType)
+    {
+        this->indexCount = indexCount;
+        this->indexType = indexType;
+        allocation = MeshGeometry().pool.Allocate(vertexData, vertexCount, indexData, indexCount * IndexSize(indexType));
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,385 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Binary cache of an imported model, stored next to the source file as "<source>.meshcache".
+// It holds the final interleaved vertex and index arrays of every mesh together with the material
+// texture references, so a warm start memory-maps the file and hands the arrays straight to glBufferData
+// without going through Assimp.
+//
+// File layout:
+//   MeshCacheHeader
+//   MeshCacheRecord[meshCount] (array offsets and counts, index size, bounds)
+//   texture references, per mesh: (uint32 length, chars) for the type and then for the path
+//   sources, per file: MeshCacheSource, then its path
+//   vertex and index arrays, every array starting at a 16 byte aligned offset
+//
+// The sources are the model file and the material libraries it names with "mtllib", since the texture references
+// come from those. A cache is only used if its version and packed vertex size match this build and every source
+// is unchanged: same size, and the same mtime or, if only the mtime moved, the same content hash. A warm start
+// so only stats the files, and hashes one only when it has been touched.
+class MeshCache
+{
+public:
+    MeshCache() = default;
+    MeshCache(const MeshCache&) = delete;
+    MeshCache& operator=(const MeshCache&) = delete;
+    ~MeshCache()
+    {
+        Close();
+    }
+
+    static string PathFor(const string &sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    // maps the cache of the given source file; returns false if there is none or it's out of date
+    bool Open(const string &sourcePath)
+    {
+        Close();
+        if (!mapFile(PathFor(sourcePath), data, size))
+            return false;
+        if (!parse())
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        if (data != nullptr)
+            munmap((void*)data, size);
+        data = nullptr;
+        size = 0;
+        meshes.clear();
+    }
+
+    // the cached meshes; their arrays point into the mapped file and stay valid while the cache is open
+    const vector<MeshData>& Meshes() const
+    {
+        return meshes;
+    }
+
+    // writes the cache for the given source file
+    static bool Write(const string &sourcePath, const vector<MeshData> &meshes)
+    {
+        vector<string> sourcePaths = materialLibraries(sourcePath);
+        sourcePaths.insert(sourcePaths.begin(), sourcePath);
+        vector<char> sources;
+        for (const string &path : sourcePaths)
+        {
+            MeshCacheSource source;
+            if (!statSource(path, source, true) && path == sourcePath)
+                return false;
+            source.pathLength = path.size();
+            sources.insert(sources.end(), (const char*)&source, (const char*)&source + sizeof(source));
+            sources.insert(sources.end(), path.begin(), path.end());
+        }
+
+        MeshCacheHeader header;
+        memcpy(header.magic, magic(), sizeof(header.magic));
+        header.version = VERSION;
+        header.vertexSize = sizeof(PackedVertex);
+        header.meshCount = meshes.size();
+        header.sourceCount = sourcePaths.size();
+        header.padding = 0;
+
+        vector<MeshCacheRecord> records(meshes.size());
+        vector<char> strings;
+        for (const MeshData &mesh : meshes)
+        {
+            for (const TextureRef &texture : mesh.textures)
+            {
+                appendString(strings, texture.type);
+                appendString(strings, texture.path);
+            }
+        }
+
+        uint64_t offset = align(sizeof(MeshCacheHeader) + records.size() * sizeof(MeshCacheRecord) + strings.size() + sources.size());
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            records[i].vertexCount = meshes[i].VertexCount();
+            records[i].indexCount = meshes[i].IndexCount();
+            records[i].indexSize = IndexSize(meshes[i].IndexType());
+            records[i].textureCount = meshes[i].textures.size();
+            records[i].bounds = meshes[i].bounds;
+            records[i].vertexOffset = offset;
+            offset = align(offset + records[i].vertexCount * sizeof(PackedVertex));
+            records[i].indexOffset = offset;
+            offset = align(offset + records[i].indexCount * records[i].indexSize);
+        }
+
+        // write to a temporary file first so a crash never leaves a truncated cache behind; it's named after the
+        // process and thread, so two writers of the same cache never write into one file
+        string cachePath = PathFor(sourcePath);
+        std::ostringstream tempName;
+        tempName << cachePath << '.' << getpid() << '-' << std::this_thread::get_id() << ".tmp";
+        string tempPath = tempName.str();
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            cout << "ERROR::MESH_CACHE:: could not write " << tempPath << endl;
+            return false;
+        }
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)records.data(), records.size() * sizeof(MeshCacheRecord));
+        out.write(strings.data(), strings.size());
+        out.write(sources.data(), sources.size());
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            pad(out, records[i].vertexOffset);
+            out.write((const char*)meshes[i].VertexData(), records[i].vertexCount * sizeof(PackedVertex));
+            pad(out, records[i].indexOffset);
+            out.write((const char*)meshes[i].IndexData(), records[i].indexCount * records[i].indexSize);
+        }
+        out.close();
+        if (!out || rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        {
+            cout << "ERROR::MESH_CACHE:: could not write " << cachePath << endl;
+            remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static const char* magic()
+    {
+        return "RGMC";
+    }
+    // bump whenever the layout of the file or of PackedVertex changes, or the arrays are processed differently
+    static const uint32_t VERSION = 6;
+
+    struct MeshCacheHeader {
+        char     magic[4];
+        uint32_t version;
+        uint32_t vertexSize;
+        uint32_t meshCount;
+        uint32_t sourceCount;
+        uint32_t padding;
+    };
+
+    struct MeshCacheRecord {
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureCount;
+        uint32_t indexSize; // 2 or 4 bytes
+        rg::Bounds bounds;
+    };
+
+    // a file the cache was built from, as it was then; a material library that was missing has an mtime of -1
+    struct MeshCacheSource {
+        int64_t  mtime;
+        uint64_t size;
+        uint64_t hash;
+        uint32_t pathLength;
+        uint32_t padding;
+    };
+
+    const char *data = nullptr;
+    size_t size = 0;
+    vector<MeshData> meshes;
+
+    bool parse()
+    {
+        if (size < sizeof(MeshCacheHeader))
+            return false;
+        const MeshCacheHeader *header = (const MeshCacheHeader*)data;
+        if (memcmp(header->magic, magic(), sizeof(header->magic)) != 0 || header->version != VERSION
+            || header->vertexSize != sizeof(PackedVertex))
+            return false;
+
+        size_t cursor = sizeof(MeshCacheHeader);
+        if (size < cursor + header->meshCount * sizeof(MeshCacheRecord))
+            return false;
+        const MeshCacheRecord *records = (const MeshCacheRecord*)(data + cursor);
+        cursor += header->meshCount * sizeof(MeshCacheRecord);
+
+        meshes.resize(header->meshCount);
+        for (unsigned int i = 0; i < header->meshCount; i++)
+        {
+            const MeshCacheRecord &record = records[i];
+            MeshData &mesh = meshes[i];
+            for (unsigned int j = 0; j < record.textureCount; j++)
+            {
+                TextureRef texture;
+                if (!readString(cursor, texture.type) || !readString(cursor, texture.path))
+                    return false;
+                mesh.textures.push_back(texture);
+            }
+            if ((record.indexSize != sizeof(uint16_t) && record.indexSize != sizeof(uint32_t))
+                || record.vertexOffset + (uint64_t)record.vertexCount * sizeof(PackedVertex) > size
+                || record.indexOffset + (uint64_t)record.indexCount * record.indexSize > size)
+                return false;
+            mesh.externalVertices = (const PackedVertex*)(data + record.vertexOffset);
+            mesh.externalVertexCount = record.vertexCount;
+            mesh.externalIndices = data + record.indexOffset;
+            mesh.externalIndexType = record.indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            mesh.externalIndexCount = record.indexCount;
+            mesh.bounds = record.bounds;
+        }
+
+        for (unsigned int i = 0; i < header->sourceCount; i++)
+        {
+            MeshCacheSource source;
+            if (cursor + sizeof(source) > size)
+                return false;
+            memcpy(&source, data + cursor, sizeof(source));
+            cursor += sizeof(source);
+            if (cursor + source.pathLength > size)
+                return false;
+            string path(data + cursor, source.pathLength);
+            cursor += source.pathLength;
+            if (!sourceUnchanged(path, source))
+                return false;
+        }
+        return true;
+    }
+
+    static bool sourceUnchanged(const string &path, const MeshCacheSource &source)
+    {
+        MeshCacheSource current;
+        if (!statSource(path, current, false))
+            return source.mtime == -1;
+        if (source.mtime == -1 || current.size != source.size)
+            return false;
+        if (current.mtime == source.mtime)
+            return true;
+        // touched, maybe without any change, e.g. by a checkout
+        return statSource(path, current, true) && current.hash == source.hash;
+    }
+
+    // the material libraries the model file names with "mtllib", relative to its directory
+    static vector<string> materialLibraries(const string &sourcePath)
+    {
+        vector<string> libraries;
+        std::ifstream in(sourcePath);
+        string directory = sourcePath.substr(0, sourcePath.find_last_of('/') + 1);
+        string line;
+        while (std::getline(in, line))
+        {
+            std::istringstream words(line);
+            string keyword, name;
+            if (!(words >> keyword) || keyword != "mtllib")
+                continue;
+            while (words >> name)
+                libraries.push_back(directory + name);
+        }
+        return libraries;
+    }
+
+    bool readString(size_t &cursor, string &value) const
+    {
+        uint32_t length;
+        if (cursor + sizeof(length) > size)
+            return false;
+        memcpy(&length, data + cursor, sizeof(length));
+        cursor += sizeof(length);
+        if (cursor + length > size)
+            return false;
+        value.assign(data + cursor, length);
+        cursor += length;
+        return true;
+    }
+
+    static void appendString(vector<char> &strings, const string &value)
+    {
+        uint32_t length = value.size();
+        strings.insert(strings.end(), (const char*)&length, (const char*)&length + sizeof(length));
+        strings.insert(strings.end(), value.begin(), value.end());
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 15) & ~uint64_t(15);
+    }
+
+    static void pad(std::ofstream &out, uint64_t offset)
+    {
+        while ((uint64_t)out.tellp() < offset)
+            out.put('\0');
+    }
+
+    static bool mapFile(const string &path, const char *&mapped, size_t &mappedSize)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            close(fd);
+            return false;
+        }
+        void *memory = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED)
+            return false;
+        mapped = (const char*)memory;
+        mappedSize = st.st_size;
+        return true;
+    }
+
+    // mtime, size and, if asked for, 64-bit FNV-1a hash of a source file's contents; a file that can't be read
+    // is left as missing
+    static bool statSource(const string &path, MeshCacheSource &info, bool hashContents)
+    {
+        info.mtime = -1;
+        info.size = 0;
+        info.hash = 0;
+        info.pathLength = 0;
+        info.padding = 0;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        if (!hashContents)
+        {
+            info.mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+            info.size = st.st_size;
+            return true;
+        }
+
+        uint64_t hash = 14695981039346656037ull;
+        // an empty file can't be mapped, and hashes to the offset basis
+        if (st.st_size > 0)
+        {
+            const char *source;
+            size_t sourceSize;
+            if (!mapFile(path, source, sourceSize))
+                return false;
+            for (size_t i = 0; i < sourceSize; i++)
+            {
+                hash ^= (unsigned char)source[i];
+                hash *= 1099511628211ull;
+            }
+            munmap((void*)source, sourceSize);
+        }
+        info.mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        info.size = st.st_size;
+        info.hash = hash;
+        return true;
+    }
+};
+#endif
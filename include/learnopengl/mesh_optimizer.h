@@ -0,0 +1,340 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <rg/Profiler.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Import-time optimization of a mesh for the GPU, run once before the mesh cache is written:
+//   1. welding: vertices that pack to the same bytes are merged and triangles that collapse are dropped
+//   2. Tipsify (Sander, Nehab, Barczak 2007): triangles are reordered to reuse the post-transform vertex cache
+//   3. overdraw: the Tipsify order is cut into clusters at points where starting over with an empty cache costs
+//      little, and the clusters are sorted so the ones facing outwards, likely in front, are drawn first
+//   4. vertex fetch: vertices are renumbered in the order the triangles first use them
+// The cache is modeled as a FIFO of VERTEX_CACHE_SIZE vertices, a conservative size for current GPUs.
+
+const unsigned int VERTEX_CACHE_SIZE = 16;
+// a cluster may be cut off where the misses per triangle so far are at most this times those of its whole run
+const float OVERDRAW_THRESHOLD = 1.05f;
+
+struct VertexCacheStats {
+    // average cache miss ratio: transformed vertices per triangle, 0.5 at best for a regular grid, 3 at worst
+    float acmr = 0.0f;
+    // average transform to vertex ratio: transformed vertices per vertex, 1 at best
+    float atvr = 0.0f;
+};
+
+// what OptimizeMesh did to a mesh, for the import log
+struct MeshOptimizerReport {
+    unsigned int verticesBefore = 0, verticesAfter = 0;
+    VertexCacheStats before, after;
+};
+
+// FIFO cache simulation over the index list
+VertexCacheStats AnalyzeVertexCache(const unsigned int *indices, size_t indexCount, size_t vertexCount)
+{
+    VertexCacheStats stats;
+    // no whole triangle to average over
+    if (indexCount < 3 || vertexCount == 0)
+        return stats;
+    // vertex i is in the cache if it was transformed less than VERTEX_CACHE_SIZE misses ago
+    vector<uint64_t> transformedAt(vertexCount, 0);
+    uint64_t misses = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        unsigned int vertex = indices[i];
+        if (transformedAt[vertex] == 0 || misses - transformedAt[vertex] >= VERTEX_CACHE_SIZE)
+            transformedAt[vertex] = ++misses;
+    }
+    stats.acmr = (float)misses / (indexCount / 3);
+    stats.atvr = (float)misses / vertexCount;
+    return stats;
+}
+
+struct packedVertexHash {
+    size_t operator()(const PackedVertex &vertex) const
+    {
+        const unsigned char *bytes = (const unsigned char*)&vertex;
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(PackedVertex); i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+};
+
+struct packedVertexEqual {
+    bool operator()(const PackedVertex &a, const PackedVertex &b) const
+    {
+        return memcmp(&a, &b, sizeof(PackedVertex)) == 0;
+    }
+};
+
+// merges bitwise identical vertices, which quantization makes more of, and drops the triangles left degenerate
+void WeldVertices(vector<PackedVertex> &vertices, vector<unsigned int> &indices)
+{
+    unordered_map<PackedVertex, unsigned int, packedVertexHash, packedVertexEqual> unique;
+    unique.reserve(vertices.size());
+    vector<unsigned int> remap(vertices.size());
+    vector<PackedVertex> welded;
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        auto inserted = unique.emplace(vertices[i], (unsigned int)welded.size());
+        if (inserted.second)
+            welded.push_back(vertices[i]);
+        remap[i] = inserted.first->second;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+        if (a == b || b == c || a == c)
+            continue;
+        indices[kept++] = a;
+        indices[kept++] = b;
+        indices[kept++] = c;
+    }
+    indices.resize(kept);
+    vertices.swap(welded);
+}
+
+// Tipsify: fans out from a vertex, emitting all its remaining triangles, and moves on to the next vertex that will
+// still be in the cache once its own triangles are emitted. Returns the reordered indices and the triangle offsets
+// at which it had to start over from a vertex off the cache (the hard boundaries), the first being 0.
+vector<unsigned int> TipsifyOrder(const vector<unsigned int> &indices, unsigned int vertexCount, vector<unsigned int> &hardBoundaries)
+{
+    unsigned int triangleCount = indices.size() / 3;
+    // triangles of every vertex, as offsets into one array
+    vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (unsigned int index : indices)
+        liveTriangles[index]++;
+    vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (unsigned int t = 0; t < triangleCount; t++)
+        for (int j = 0; j < 3; j++)
+            adjacency[fill[indices[t * 3 + j]]++] = t;
+
+    vector<unsigned int> cacheTime(vertexCount, 0);
+    vector<bool> emitted(triangleCount, false);
+    vector<unsigned int> deadEnds;
+    vector<unsigned int> candidates;
+    vector<unsigned int> order;
+    order.reserve(indices.size());
+    hardBoundaries.assign(1, 0);
+
+    unsigned int time = VERTEX_CACHE_SIZE + 1;
+    unsigned int cursor = 0;
+    int fanning = vertexCount > 0 ? 0 : -1;
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (unsigned int a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+        {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+                continue;
+            for (int j = 0; j < 3; j++)
+            {
+                unsigned int v = indices[t * 3 + j];
+                order.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > VERTEX_CACHE_SIZE)
+                    cacheTime[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // the candidate still in the cache the longest, if its remaining triangles fit; otherwise any with some left
+        int next = -1, best = -1;
+        for (unsigned int v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+                continue;
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= VERTEX_CACHE_SIZE)
+                priority = time - cacheTime[v];
+            if (priority > best)
+            {
+                best = priority;
+                next = v;
+            }
+        }
+        if (next == -1)
+        {
+            // a dead end: back to a recently used vertex with triangles left, else the next one in input order
+            while (!deadEnds.empty() && next == -1)
+            {
+                unsigned int v = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[v] > 0)
+                    next = v;
+            }
+            while (next == -1 && cursor < vertexCount)
+            {
+                if (liveTriangles[cursor] > 0)
+                    next = cursor;
+                cursor++;
+            }
+            if (next != -1 && time - cacheTime[next] > VERTEX_CACHE_SIZE)
+                hardBoundaries.push_back(order.size() / 3);
+        }
+        fanning = next;
+    }
+    return order;
+}
+
+// Splits the clusters between hard boundaries further where the cache would miss little by starting over, then
+// sorts all clusters front to back by how far out they face from the center of the mesh.
+void OptimizeOverdraw(vector<unsigned int> &indices, const vector<unsigned int> &hardBoundaries, const vector<glm::vec3> &positions)
+{
+    unsigned int triangleCount = indices.size() / 3;
+    vector<unsigned int> boundaries;
+    // One cache simulation for the whole mesh; a vertex transformed before start counts as not in the cache, so
+    // moving start up to the current miss count empties the cache without touching the array.
+    vector<uint64_t> transformedAt(positions.size(), 0);
+    uint64_t misses = 0;
+    auto simulate = [&](unsigned int t, uint64_t start)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            unsigned int vertex = indices[t * 3 + j];
+            if (transformedAt[vertex] <= start || misses - transformedAt[vertex] >= VERTEX_CACHE_SIZE)
+                transformedAt[vertex] = ++misses;
+        }
+    };
+    for (unsigned int h = 0; h < hardBoundaries.size(); h++)
+    {
+        unsigned int begin = hardBoundaries[h];
+        unsigned int end = h + 1 < hardBoundaries.size() ? hardBoundaries[h + 1] : triangleCount;
+        if (begin >= end)
+            continue;
+        // the ACMR of the whole cluster from an empty cache
+        uint64_t start = misses;
+        for (unsigned int t = begin; t < end; t++)
+            simulate(t, start);
+        float clusterAcmr = (float)(misses - start) / (end - begin);
+
+        // again from an empty cache, which is emptied at every cut
+        start = misses;
+        unsigned int clusterStart = begin;
+        boundaries.push_back(begin);
+        for (unsigned int t = begin; t < end; t++)
+        {
+            simulate(t, start);
+            unsigned int clusterTriangles = t + 1 - clusterStart;
+            if (t + 1 < end && (float)(misses - start) / clusterTriangles <= OVERDRAW_THRESHOLD * clusterAcmr)
+            {
+                boundaries.push_back(t + 1);
+                clusterStart = t + 1;
+                start = misses;
+            }
+        }
+    }
+    boundaries.push_back(triangleCount);
+
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    for (unsigned int t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3 &a = positions[indices[t * 3]], &b = positions[indices[t * 3 + 1]], &c = positions[indices[t * 3 + 2]];
+        float area = glm::length(glm::cross(b - a, c - a));
+        meshCenter += (a + b + c) * (area / 3.0f);
+        meshArea += area;
+    }
+    if (meshArea > 0.0f)
+        meshCenter /= meshArea;
+
+    struct Cluster {
+        unsigned int begin, end;
+        float facing;
+    };
+    vector<Cluster> clusters;
+    for (unsigned int i = 0; i + 1 < boundaries.size(); i++)
+    {
+        Cluster cluster{boundaries[i], boundaries[i + 1], 0.0f};
+        glm::vec3 center(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (unsigned int t = cluster.begin; t < cluster.end; t++)
+        {
+            const glm::vec3 &a = positions[indices[t * 3]], &b = positions[indices[t * 3 + 1]], &c = positions[indices[t * 3 + 2]];
+            glm::vec3 cross = glm::cross(b - a, c - a);
+            float triangleArea = glm::length(cross);
+            center += (a + b + c) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        if (area > 0.0f && glm::length(normal) > 0.0f)
+            cluster.facing = glm::dot(center / area - meshCenter, glm::normalize(normal));
+        clusters.push_back(cluster);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) { return a.facing > b.facing; });
+
+    vector<unsigned int> sorted;
+    sorted.reserve(indices.size());
+    for (const Cluster &cluster : clusters)
+        sorted.insert(sorted.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+    indices.swap(sorted);
+}
+
+// renumbers the vertices in the order of their first use, so fetching them walks the vertex buffer forwards
+void OptimizeVertexFetch(vector<PackedVertex> &vertices, vector<unsigned int> &indices)
+{
+    const unsigned int unused = ~0u;
+    vector<unsigned int> remap(vertices.size(), unused);
+    vector<PackedVertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int &index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+// Runs all of the above on an imported mesh whose vertices are packed within its bounds, in place.
+MeshOptimizerReport OptimizeMesh(MeshData &mesh)
+{
+    RG_PROFILE_ZONE("optimize mesh");
+    MeshOptimizerReport report;
+    report.verticesBefore = mesh.vertices.size();
+    report.before = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+
+    WeldVertices(mesh.vertices, mesh.indices);
+    vector<unsigned int> hardBoundaries;
+    mesh.indices = TipsifyOrder(mesh.indices, mesh.vertices.size(), hardBoundaries);
+
+    vector<glm::vec3> positions(mesh.vertices.size());
+    glm::vec3 extent = mesh.bounds.max - mesh.bounds.min;
+    for (unsigned int i = 0; i < mesh.vertices.size(); i++)
+    {
+        const uint16_t *p = mesh.vertices[i].Position;
+        positions[i] = mesh.bounds.min + glm::vec3(p[0], p[1], p[2]) / 65535.0f * extent;
+    }
+    OptimizeOverdraw(mesh.indices, hardBoundaries, positions);
+    OptimizeVertexFetch(mesh.vertices, mesh.indices);
+
+    report.verticesAfter = mesh.vertices.size();
+    report.after = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    return report;
+}
+
+#endif
@@ -11,33 +11,71 @@
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/resources.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture.h>
+#include <rg/Profiler.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <algorithm>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false, TextureUsage usage = TEXTURE_COLOR);
 
+// how a material texture type from the importer is sampled
+TextureUsage TextureUsageFor(const string &type)
+{
+    if (type == "texture_normal")
+        return TEXTURE_NORMAL;
+    if (type == "texture_height")
+        return TEXTURE_HEIGHT;
+    return TEXTURE_COLOR;
+}
 
+// everything the importer produces for a model, before any GL object exists
+struct ModelData {
+    string path;
+    string directory;
+    vector<MeshData> meshes;
+    // keeps the mapped cache file alive until the meshes are uploaded, if they came from the cache
+    shared_ptr<MeshCache> cache;
+};
 
 class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
+    // registry references held by the model; textures and mesh buffers are shared with every other model
+    // that loaded the same file
+    vector<rg::TextureHandle> textureHandles;
+    vector<rg::MeshHandle>    meshHandles;
     string directory;
     bool gammaCorrection;
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
     {
-        loadModel(path);
+        ModelData data;
+        if (Import(path, data))
+        {
+            Upload(data);
+            for (const string &texturePath : TexturePaths())
+                SetTexture(texturePath, AcquireTexture(directory + '/' + texturePath, TextureUsageFor(textureType(texturePath))));
+        }
+    }
+
+    // empty model, filled in later by the AssetLoader
+    Model() : gammaCorrection(false)
+    {
     }
 
     // draws the model, and thus all its meshes
@@ -47,33 +85,172 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // draws the meshes whose bounds, placed with the model matrix, intersect the frustum; the model matrix
+    // still has to be set on the shader by the caller
+    void Draw(Shader &shader, const rg::Frustum &frustum, const glm::mat4 &model)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            if (frustum.Intersects(rg::TransformSphere(meshes[i].bounds, model)))
+                meshes[i].Draw(shader);
+    }
+
+    // model-space bounds of all meshes together
+    rg::Bounds Bounds() const
+    {
+        if (meshes.empty())
+            return rg::Bounds();
+        rg::Bounds bounds = meshes[0].bounds;
+        for(unsigned int i = 1; i < meshes.size(); i++)
+            bounds = rg::Bounds::Union(bounds, meshes[i].bounds);
+        return bounds;
+    }
+
+    // draws every instance in the buffer with one instanced draw call per mesh
+    void DrawInstanced(Shader &shader, const InstanceBuffer &instances)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instances);
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
+        glslIdentifierPrefix = prefix;
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.SetSamplerPrefix(prefix);
         }
     }
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+
+    // CPU half of loading: maps the mesh cache or, if it's missing or stale, imports the file with ASSIMP and
+    // writes a new cache. Touches no GL state, so it may run on a worker thread.
+    static bool Import(string const &path, ModelData &data)
     {
+        RG_PROFILE_ZONE_DETAIL("import model", path);
+        data.path = path;
+        // retrieve the directory path of the filepath
+        data.directory = path.substr(0, path.find_last_of('/'));
+
+        // a valid mesh cache already holds the final vertex and index arrays, so Assimp is skipped entirely
+        shared_ptr<MeshCache> cache = make_shared<MeshCache>();
+        if (cache->Open(path))
+        {
+            data.meshes = cache->Meshes();
+            data.cache = cache;
+            return true;
+        }
+
         // read file via ASSIMP
+        RG_PROFILE_ZONE("assimp import");
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
-
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, data.meshes);
+
+        // reordered for the vertex cache once here, so the cache and every later start get the optimized arrays
+        for (unsigned int i = 0; i < data.meshes.size(); i++)
+        {
+            MeshOptimizerReport report = OptimizeMesh(data.meshes[i]);
+            data.meshes[i].NarrowIndices();
+            // imports run on the loader's workers; the line goes out in one write so lines of two imports don't mix
+            ostringstream line;
+            line << "MESH_OPTIMIZER:: " << path << " mesh " << i << ": vertices " << report.verticesBefore << " -> "
+                 << report.verticesAfter << ", ACMR " << report.before.acmr << " -> " << report.after.acmr
+                 << ", ATVR " << report.before.atvr << " -> " << report.after.atvr << '\n';
+            cout << line.str() << flush;
+        }
+        MeshCache::Write(path, data.meshes);
+        return true;
+    }
+
+    // GL half of loading: creates the meshes from imported data, reusing the buffers of meshes that are already
+    // resident. Textures are only referenced at this point (with id 0) and get their ids through SetTexture once
+    // they are loaded.
+    void Upload(const ModelData &data)
+    {
+        RG_PROFILE_ZONE_DETAIL("upload model", data.path);
+        directory = data.directory;
+        for (unsigned int i = 0; i < data.meshes.size(); i++)
+        {
+            const MeshData &meshData = data.meshes[i];
+            vector<Texture> textures;
+            for (const TextureRef &ref : meshData.textures)
+                textures.push_back(Texture{0, ref.type, ref.path});
+
+            bool created;
+            rg::MeshHandle handle = rg::Resources().Meshes().Acquire(rg::ResourceManager::Key(data.path, "mesh=" + std::to_string(i)), created);
+            if (created)
+            {
+                meshes.push_back(Mesh(meshData.VertexData(), meshData.VertexCount(), meshData.IndexData(), meshData.IndexCount(),
+                                      meshData.IndexType(), textures));
+                size_t bytes = meshData.VertexCount() * sizeof(PackedVertex) + meshData.IndexBytes();
+                rg::Resources().Meshes().Set(handle, rg::MeshResource{&MeshGeometry().pool, meshes.back().allocation,
+                                                                      meshes.back().indexCount, meshes.back().indexType, bytes});
+            }
+            else
+            {
+                rg::MeshResource shared = rg::Resources().Meshes().Get(handle);
+                meshes.push_back(Mesh(shared.allocation, shared.indexCount, shared.indexType, textures));
+            }
+            meshes.back().bounds = meshData.bounds;
+            meshes.back().SetSamplerPrefix(glslIdentifierPrefix);
+            meshHandles.push_back(handle);
+        }
+    }
+
+    // every distinct texture path referenced by the meshes, relative to the model directory
+    vector<string> TexturePaths() const
+    {
+        vector<string> paths;
+        for (const Mesh &mesh : meshes)
+            for (const Texture &texture : mesh.textures)
+                if (std::find(paths.begin(), paths.end(), texture.path) == paths.end())
+                    paths.push_back(texture.path);
+        return paths;
+    }
+
+    // hands a resident texture to every mesh that references the path; the model takes over the reference
+    void SetTexture(const string &path, rg::TextureHandle handle)
+    {
+        unsigned int id = rg::Resources().Textures().Get(handle).id;
+        for (Mesh &mesh : meshes)
+            for (Texture &texture : mesh.textures)
+                if (texture.path == path)
+                    texture.id = id;
+        textureHandles.push_back(handle);
+    }
+
+    // drops the model's meshes and its references to shared resources; whatever no other model uses is freed
+    void Release()
+    {
+        // the meshes' ranges go back to the geometry pool with the last reference to them
+        meshes.clear();
+        for (rg::MeshHandle handle : meshHandles)
+            rg::Resources().Meshes().Release(handle);
+        for (rg::TextureHandle handle : textureHandles)
+            rg::Resources().Textures().Release(handle);
+        meshHandles.clear();
+        textureHandles.clear();
+    }
+
+private:
+    string glslIdentifierPrefix;
+
+    // type of the first mesh texture with the given path
+    string textureType(const string &path) const
+    {
+        for (const Mesh &mesh : meshes)
+            for (const Texture &texture : mesh.textures)
+                if (texture.path == path)
+                    return texture.type;
+        return "";
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, vector<MeshData> &meshes)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -86,18 +263,19 @@ private:
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, meshes);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
+        MeshData data;
         vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
-
+        vector<unsigned int> &indices = data.indices;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
@@ -151,6 +329,9 @@ private:
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
         }
+        // the vertices are quantized relative to their bounds, which the shader gets to decode them
+        data.bounds = rg::Bounds::Of(vertices.data(), vertices.size());
+        data.vertices = PackVertices(vertices.data(), vertices.size(), data.bounds);
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -164,96 +345,32 @@ private:
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", data.textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
+        loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", data.textures);
 
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // collects the material textures of a given type; they are loaded later, once per model
+    static void loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName, vector<TextureRef> &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(TextureRef{typeName, str.C_Str()});
         }
-        return textures;
     }
 };
 
-
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma, TextureUsage usage)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return LoadTexture(directory + '/' + string(path), usage);
 }
 #endif
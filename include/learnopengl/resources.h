@@ -0,0 +1,60 @@
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <learnopengl/shader.h>
+#include <learnopengl/texture.h>
+#include <rg/ResourceManager.h>
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// Loading helpers that go through the process-wide rg::ResourceManager, so a file that is already resident is
+// shared instead of loaded again. They run on the GL thread; the AssetLoader has asynchronous versions.
+
+// registry key of a 2D texture loaded for the given usage
+string TextureKey(const string &path, TextureUsage usage)
+{
+    return rg::ResourceManager::Key(path, "usage=" + std::to_string((int)usage));
+}
+
+// registry key of a cubemap made of the given faces
+string CubemapKey(const vector<string> &faces)
+{
+    string parameters = "cubemap";
+    for (unsigned int i = 1; i < faces.size(); i++)
+        parameters += '|' + rg::ResourceManager::Key(faces[i]);
+    return rg::ResourceManager::Key(faces.empty() ? "" : faces[0], parameters);
+}
+
+// the registry entry of a 2D texture, loading it if it isn't resident yet
+rg::TextureHandle AcquireTexture(const string &path, TextureUsage usage = TEXTURE_COLOR)
+{
+    bool created;
+    rg::TextureHandle handle = rg::Resources().Textures().Acquire(TextureKey(path, usage), created);
+    if (created)
+    {
+        TextureData texture = PrepareTexture(path, usage);
+        rg::Resources().Textures().Set(handle, rg::TextureResource{UploadTexture(texture), GL_TEXTURE_2D, texture.GpuBytes()});
+    }
+    return handle;
+}
+
+// compiles the program or shares the one already built from the same sources; the program stays registered
+// for the lifetime of the process
+Shader AcquireShader(const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr)
+{
+    string key = rg::ResourceManager::Key(vertexPath) + '|' + rg::ResourceManager::Key(fragmentPath);
+    if (geometryPath != nullptr)
+        key += '|' + rg::ResourceManager::Key(geometryPath);
+
+    bool created;
+    rg::ProgramHandle handle = rg::Resources().Programs().Acquire(key, created);
+    if (!created)
+        return Shader(rg::Resources().Programs().Get(handle).id);
+
+    Shader shader(vertexPath, fragmentPath, geometryPath);
+    rg::Resources().Programs().Set(handle, rg::ProgramResource{shader.ID});
+    return shader;
+}
+#endif
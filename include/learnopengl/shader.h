@@ -3,8 +3,13 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <rg/GLState.h>
+#include <rg/Profiler.h>
+#include <rg/Uniform.h>
+#include <rg/UniformBuffer.h>
 
 #include <string>
+#include <type_traits>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -13,10 +18,17 @@ class Shader
 {
 public:
     unsigned int ID;
+    // wraps a program that is already linked, e.g. one shared through the resource registry
+    // ------------------------------------------------------------------------
+    explicit Shader(unsigned int programID) : ID(programID)
+    {
+        uniforms.Reflect(ID);
+    }
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
+        RG_PROFILE_ZONE_DETAIL("compile shader", fragmentPath);
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
 
@@ -46,8 +58,8 @@ public:
             vShaderFile.close();
             fShaderFile.close();
             // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            vertexCode = expandIncludes(vShaderStream.str(), vertexPath);
+            fragmentCode = expandIncludes(fShaderStream.str(), fragmentPath);			
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
             {
@@ -57,7 +69,7 @@ public:
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                geometryCode = expandIncludes(gShaderStream.str(), geometryPath);
             }
         }
         catch (std::ifstream::failure& e)
@@ -96,6 +108,9 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        // look up every active uniform once, so setting one by name never has to ask the driver
+        uniforms.Reflect(ID);
+        rg::BindUniformBlocks(ID);
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -107,68 +122,128 @@ public:
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        rg::State().UseProgram(ID);
+    }
+    // location of a uniform from the table built at link time; -1 if it isn't active
+    // ------------------------------------------------------------------------
+    GLint uniformLocation(const std::string &name) const
+    {
+        return uniforms.Location(name);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
+    // typed handle of a uniform: resolve it once outside the hot path, then set it without any lookup
+    // ------------------------------------------------------------------------
+    template<typename T>
+    rg::Uniform<T> uniform(const std::string &name) const
+    {
+        return uniforms.Resolve<T>(name);
+    }
+    template<typename T>
+    void set(rg::Uniform<T> uniform, const typename std::common_type<T>::type &value) const
+    {
+        rg::SetUniform(uniform.location, value);
+    }
+    // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(uniforms.Location(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(uniforms.Location(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(uniforms.Location(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(uniforms.Location(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(uniforms.Location(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(uniforms.Location(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(uniforms.Location(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(uniforms.Location(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(uniforms.Location(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(uniforms.Location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(uniforms.Location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(uniforms.Location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // active uniforms of the program, by name
+    rg::UniformTable uniforms;
+
+    // replaces every line of the form #include "file" with the contents of that file, relative to the directory
+    // of the including one; GLSL has no includes of its own
+    // ------------------------------------------------------------------------
+    static std::string expandIncludes(const std::string &code, const std::string &path, int depth = 0)
+    {
+        if (depth > 8)
+        {
+            std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP " << path << std::endl;
+            return code;
+        }
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        std::istringstream in(code);
+        std::ostringstream out;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            size_t directive = line.find("#include");
+            size_t open = line.find('"');
+            size_t close = line.rfind('"');
+            if (directive == std::string::npos || line.find_first_not_of(" \t") != directive || open == close)
+            {
+                out << line << '\n';
+                continue;
+            }
+            std::string includePath = directory + line.substr(open + 1, close - open - 1);
+            std::ifstream includeFile(includePath);
+            if (!includeFile)
+            {
+                std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND " << includePath << std::endl;
+                continue;
+            }
+            std::stringstream included;
+            included << includeFile.rdbuf();
+            out << expandIncludes(included.str(), includePath, depth + 1) << '\n';
+        }
+        return out.str();
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,411 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/resources.h>
+#include <learnopengl/shader.h>
+#include <rg/Frustum.h>
+#include <rg/GLState.h>
+#include <rg/Profiler.h>
+#include <rg/ThreadPool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Height field terrain around the village, TERRAIN_SIZE units on a side, drawn with CDLOD (continuous
+// distance-dependent level of detail, Strugar 2009). The terrain is a quadtree of nodes, each drawn with the
+// same TERRAIN_GRID x TERRAIN_GRID vertex grid, so a node of level l has vertices 2^l times as far apart as one
+// of level 0. Every frame the tree is walked from the root and a node is split while its children are within
+// the range of their level; the ranges double per level, so the number of nodes drawn depends on the view
+// distance, not on the size of the world. Towards the end of its range every node morphs its odd vertices onto
+// the grid of its parent, which meets the parent's grid exactly at the border and leaves no cracks or pops.
+//
+// The heights of a node are generated on worker threads when the walk first needs it and uploaded on the GL
+// thread a few per frame, as an R32F texture the vertex shader reads. Until a node is resident its parent
+// draws the area instead. At most the residency budget of node textures is kept; the ones unused the longest
+// are dropped first, except for the root, which is generated up front and always there to fall back on.
+
+const float TERRAIN_SIZE = 4096.0f;
+const int TERRAIN_GRID = 32;
+const int TERRAIN_LEVELS = 8;
+// nodes of level 0 are drawn up to this far away, those of every next level twice as far as the one before
+const float TERRAIN_LOD0_RANGE = 48.0f;
+// fraction of its range after which a node starts morphing into its parent's grid
+const float TERRAIN_MORPH_START = 0.7f;
+
+float terrainHash(int x, int z)
+{
+    uint32_t h = (uint32_t)x * 374761393u + (uint32_t)z * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return (h ^ (h >> 16)) / 4294967295.0f;
+}
+
+// smoothly interpolated lattice noise in [0, 1]
+float terrainNoise(float x, float z)
+{
+    float fx = std::floor(x), fz = std::floor(z);
+    int ix = (int)fx, iz = (int)fz;
+    float tx = x - fx, tz = z - fz;
+    tx = tx * tx * (3.0f - 2.0f * tx);
+    tz = tz * tz * (3.0f - 2.0f * tz);
+    float a = terrainHash(ix, iz), b = terrainHash(ix + 1, iz);
+    float c = terrainHash(ix, iz + 1), d = terrainHash(ix + 1, iz + 1);
+    return (a + (b - a) * tx) + ((c + (d - c) * tx) - (a + (b - a) * tx)) * tz;
+}
+
+// Height of the terrain; safe to call from any thread. The village plot stays flat just below the parallax
+// floor, and hills rise past its fence.
+float TerrainHeight(float x, float z)
+{
+    float noise = 0.0f, amplitude = 0.5f, frequency = 1.0f / 300.0f, total = 0.0f;
+    for (int octave = 0; octave < 6; octave++)
+    {
+        noise += terrainNoise(x * frequency, z * frequency) * amplitude;
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+    float edge = std::max(std::abs(x), std::abs(z));
+    float t = std::min(std::max((edge - 14.0f) / 46.0f, 0.0f), 1.0f);
+    return -0.05f + t * t * (3.0f - 2.0f * t) * noise / total * 80.0f;
+}
+
+class Terrain
+{
+public:
+    // residencyBudget node textures are kept at most, and uploadsPerFrame new ones uploaded per frame
+    explicit Terrain(unsigned int residencyBudget = 512, unsigned int uploadsPerFrame = 8)
+        : residencyBudget(residencyBudget), uploadsPerFrame(uploadsPerFrame),
+          shader(AcquireShader("resources/shaders/terrain.vs", "resources/shaders/terrain.fs")), pool(2)
+    {
+        createGrid();
+        shader.use();
+        shader.setInt("heightMap", 0);
+        shader.setInt("grass", 1);
+        nodeRectUniform = shader.uniform<glm::vec3>("nodeRect");
+        morphRangeUniform = shader.uniform<glm::vec2>("morphRange");
+
+        // the root is always resident, so there is something to draw from the first frame on
+        Chunk &root = chunks[key(TERRAIN_LEVELS - 1, 0, 0)];
+        shared_ptr<Heights> heights = generate(TERRAIN_LEVELS - 1, 0, 0);
+        upload(root, *heights);
+    }
+
+    Terrain(const Terrain&) = delete;
+    Terrain& operator=(const Terrain&) = delete;
+
+    ~Terrain()
+    {
+        for (auto &entry : chunks)
+            if (entry.second.texture != 0)
+                glDeleteTextures(1, &entry.second.texture);
+    }
+
+    // the forward shader the terrain is drawn with, for setting up its samplers
+    Shader& GetShader()
+    {
+        return shader;
+    }
+
+    // Picks the nodes to draw from the camera position, requests the heights of nodes it would rather draw,
+    // uploads heights that have arrived and drops textures over the budget. Once a frame, before Draw().
+    void Update(const glm::vec3 &cameraPosition, const rg::Frustum &frustum)
+    {
+        RG_PROFILE_ZONE("terrain update");
+        frame++;
+        uploadReady();
+        selection.clear();
+        selectNode(TERRAIN_LEVELS - 1, 0, 0, cameraPosition, frustum);
+        evict();
+    }
+
+    // draws the nodes picked by the last Update() with the grass texture
+    void Draw(unsigned int grassTexture)
+    {
+        shader.use();
+        rg::State().BindVertexArray(VAO);
+        rg::State().BindTexture(1, GL_TEXTURE_2D, grassTexture);
+        for (const Selected &draw : selection)
+        {
+            float size = nodeSize(draw.level);
+            float range = lodRange(draw.level);
+            shader.set(nodeRectUniform, glm::vec3(nodeOrigin(draw.x, draw.level), nodeOrigin(draw.y, draw.level), size));
+            shader.set(morphRangeUniform, glm::vec2(range * TERRAIN_MORPH_START, range));
+            rg::State().BindTexture(0, GL_TEXTURE_2D, draw.texture);
+            glDrawElements(GL_TRIANGLES, draw.quarters == ALL_QUARTERS ? quarterIndexCount * 4 : quarterIndexCount,
+                           GL_UNSIGNED_SHORT, (void*)(size_t)(draw.quarters == ALL_QUARTERS ? 0 : draw.quarters * quarterIndexCount * sizeof(uint16_t)));
+        }
+    }
+
+    // nodes drawn by the last Update()
+    unsigned int DrawCount() const
+    {
+        return selection.size();
+    }
+
+    unsigned int ResidentCount() const
+    {
+        return residentCount;
+    }
+
+private:
+    static const int ALL_QUARTERS = 4;
+    // requests in flight on the workers at most; the walk asks again next frame for whatever didn't fit
+    static const unsigned int MAX_PENDING = 32;
+
+    // heights of a node's grid with a border of one sample, for the normals at its edges
+    struct Heights
+    {
+        uint64_t key;
+        vector<float> samples;
+        float minHeight, maxHeight;
+    };
+
+    struct Chunk
+    {
+        unsigned int texture = 0;
+        float minHeight = 0.0f, maxHeight = 0.0f;
+        bool pending = false;
+        uint64_t lastUsed = 0;
+    };
+
+    // a node, or one quarter of it, to draw
+    struct Selected
+    {
+        int level, x, y;
+        int quarters; // 0-3 for one quarter, ALL_QUARTERS for the whole node
+        unsigned int texture;
+    };
+
+    unsigned int residencyBudget, uploadsPerFrame;
+    Shader shader;
+    rg::Uniform<glm::vec3> nodeRectUniform;
+    rg::Uniform<glm::vec2> morphRangeUniform;
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int quarterIndexCount = 0;
+    unordered_map<uint64_t, Chunk> chunks;
+    unsigned int residentCount = 0, pendingCount = 0;
+    vector<Selected> selection;
+    uint64_t frame = 0;
+
+    std::mutex mutex;
+    // generated heights waiting for the GL thread
+    std::deque<shared_ptr<Heights>> ready;
+    // declared last so the workers are joined before the queue they report to is destroyed
+    rg::ThreadPool pool;
+
+    static uint64_t key(int level, int x, int y)
+    {
+        return ((uint64_t)level << 48) | ((uint64_t)(uint32_t)x << 24) | (uint64_t)(uint32_t)y;
+    }
+
+    static float nodeSize(int level)
+    {
+        return TERRAIN_SIZE / (float)(1 << (TERRAIN_LEVELS - 1 - level));
+    }
+
+    // world x or z of the corner of the node with the given index along that axis
+    static float nodeOrigin(int index, int level)
+    {
+        return -TERRAIN_SIZE / 2.0f + index * nodeSize(level);
+    }
+
+    static float lodRange(int level)
+    {
+        return TERRAIN_LOD0_RANGE * (float)(1 << level);
+    }
+
+    static shared_ptr<Heights> generate(int level, int x, int y)
+    {
+        RG_PROFILE_ZONE("generate terrain node");
+        shared_ptr<Heights> heights = make_shared<Heights>();
+        heights->key = key(level, x, y);
+        const int side = TERRAIN_GRID + 3;
+        heights->samples.resize(side * side);
+        heights->minHeight = heights->maxHeight = TerrainHeight(nodeOrigin(x, level), nodeOrigin(y, level));
+        float spacing = nodeSize(level) / TERRAIN_GRID;
+        for (int j = 0; j < side; j++)
+        {
+            for (int i = 0; i < side; i++)
+            {
+                float h = TerrainHeight(nodeOrigin(x, level) + (i - 1) * spacing, nodeOrigin(y, level) + (j - 1) * spacing);
+                heights->samples[j * side + i] = h;
+                // the border is outside the node and doesn't count towards its bounds
+                if (i >= 1 && i <= TERRAIN_GRID + 1 && j >= 1 && j <= TERRAIN_GRID + 1)
+                {
+                    heights->minHeight = std::min(heights->minHeight, h);
+                    heights->maxHeight = std::max(heights->maxHeight, h);
+                }
+            }
+        }
+        return heights;
+    }
+
+    void upload(Chunk &chunk, const Heights &heights)
+    {
+        const int side = TERRAIN_GRID + 3;
+        glGenTextures(1, &chunk.texture);
+        rg::State().BindTexture(0, GL_TEXTURE_2D, chunk.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, side, side, 0, GL_RED, GL_FLOAT, heights.samples.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        chunk.minHeight = heights.minHeight;
+        chunk.maxHeight = heights.maxHeight;
+        chunk.pending = false;
+        chunk.lastUsed = frame;
+        residentCount++;
+    }
+
+    void request(uint64_t nodeKey, int level, int x, int y)
+    {
+        if (pendingCount >= MAX_PENDING)
+            return;
+        Chunk &chunk = chunks[nodeKey];
+        chunk.pending = true;
+        pendingCount++;
+        pool.Submit([this, level, x, y]()
+        {
+            shared_ptr<Heights> heights = generate(level, x, y);
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(heights);
+        });
+    }
+
+    void uploadReady()
+    {
+        for (unsigned int i = 0; i < uploadsPerFrame; i++)
+        {
+            shared_ptr<Heights> heights;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (ready.empty())
+                    return;
+                heights = ready.front();
+                ready.pop_front();
+            }
+            pendingCount--;
+            upload(chunks[heights->key], *heights);
+        }
+    }
+
+    // the resident chunk of a node, or nullptr after requesting it if it isn't yet
+    Chunk* resident(int level, int x, int y)
+    {
+        uint64_t nodeKey = key(level, x, y);
+        auto found = chunks.find(nodeKey);
+        if (found == chunks.end())
+        {
+            request(nodeKey, level, x, y);
+            return nullptr;
+        }
+        if (found->second.pending)
+            return nullptr;
+        found->second.lastUsed = frame;
+        return &found->second;
+    }
+
+    static bool boxInRange(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &point, float range)
+    {
+        glm::vec3 closest = glm::min(glm::max(point, min), max);
+        glm::vec3 offset = closest - point;
+        return glm::dot(offset, offset) <= range * range;
+    }
+
+    // Adds the node, which has to be resident, or the parts of it its children can't draw to the selection.
+    // Returns false if the node is out of the range of its level, in which case its parent draws the area.
+    bool selectNode(int level, int x, int y, const glm::vec3 &cameraPosition, const rg::Frustum &frustum)
+    {
+        const Chunk &chunk = chunks[key(level, x, y)];
+        glm::vec3 min(nodeOrigin(x, level), chunk.minHeight, nodeOrigin(y, level));
+        glm::vec3 max(min.x + nodeSize(level), chunk.maxHeight, min.z + nodeSize(level));
+        if (!boxInRange(min, max, cameraPosition, lodRange(level)))
+            return false;
+        if (!frustum.Intersects(min, max))
+            return true;
+        if (level == 0 || !boxInRange(min, max, cameraPosition, lodRange(level - 1)))
+        {
+            selection.push_back(Selected{level, x, y, ALL_QUARTERS, chunk.texture});
+            return true;
+        }
+        for (int quarter = 0; quarter < 4; quarter++)
+        {
+            int childX = x * 2 + (quarter & 1), childY = y * 2 + (quarter >> 1);
+            if (resident(level - 1, childX, childY) == nullptr || !selectNode(level - 1, childX, childY, cameraPosition, frustum))
+                selection.push_back(Selected{level, x, y, quarter, chunks[key(level, x, y)].texture});
+        }
+        return true;
+    }
+
+    // drops the textures unused the longest until the budget is met; nothing drawn this frame goes, nor the root
+    void evict()
+    {
+        if (residentCount <= residencyBudget)
+            return;
+        vector<pair<uint64_t, uint64_t>> candidates; // last used, key
+        uint64_t rootKey = key(TERRAIN_LEVELS - 1, 0, 0);
+        for (const auto &entry : chunks)
+            if (!entry.second.pending && entry.second.lastUsed < frame && entry.first != rootKey)
+                candidates.emplace_back(entry.second.lastUsed, entry.first);
+        std::sort(candidates.begin(), candidates.end());
+        for (unsigned int i = 0; i < candidates.size() && residentCount > residencyBudget; i++)
+        {
+            glDeleteTextures(1, &chunks[candidates[i].second].texture);
+            chunks.erase(candidates[i].second);
+            residentCount--;
+        }
+    }
+
+    // One (TERRAIN_GRID + 1)^2 vertex grid over [0, 1]^2 for every node, its triangles ordered by quarter so
+    // a quarter of a node is one contiguous range of indices.
+    void createGrid()
+    {
+        vector<glm::vec2> vertices;
+        for (int j = 0; j <= TERRAIN_GRID; j++)
+            for (int i = 0; i <= TERRAIN_GRID; i++)
+                vertices.push_back(glm::vec2(i, j) / (float)TERRAIN_GRID);
+        vector<uint16_t> indices;
+        const int half = TERRAIN_GRID / 2;
+        for (int quarter = 0; quarter < 4; quarter++)
+        {
+            int i0 = (quarter & 1) * half, j0 = (quarter >> 1) * half;
+            for (int j = j0; j < j0 + half; j++)
+            {
+                for (int i = i0; i < i0 + half; i++)
+                {
+                    uint16_t a = j * (TERRAIN_GRID + 1) + i, b = a + 1;
+                    uint16_t c = a + TERRAIN_GRID + 1, d = c + 1;
+                    uint16_t triangles[] = { a, c, b,  b, c, d };
+                    indices.insert(indices.end(), triangles, triangles + 6);
+                }
+            }
+        }
+        quarterIndexCount = indices.size() / 4;
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        rg::State().BindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+        rg::State().BindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/cone_map.h>
+#include <learnopengl/texture_compression.h>
+#include <rg/Profiler.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Loading a texture is split into decoding the image file, which only needs the CPU and may run on a worker
+// thread, and uploading the decoded pixels, which has to happen on the thread that owns the GL context.
+// 2D textures are block compressed in the CPU half (see texture_compression.h).
+
+// decoded image; owns its pixels
+struct ImageData {
+    unsigned char *pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    string path;
+
+    ImageData() = default;
+    ImageData(const ImageData&) = delete;
+    ImageData& operator=(const ImageData&) = delete;
+    ImageData(ImageData &&other) noexcept
+    {
+        *this = std::move(other);
+    }
+    ImageData& operator=(ImageData &&other) noexcept
+    {
+        std::swap(pixels, other.pixels);
+        width = other.width;
+        height = other.height;
+        components = other.components;
+        path = std::move(other.path);
+        return *this;
+    }
+    ~ImageData()
+    {
+        if (pixels != nullptr)
+            stbi_image_free(pixels);
+    }
+};
+
+// decodes an image file; safe to call from any thread
+ImageData DecodeImage(const string &path)
+{
+    RG_PROFILE_ZONE_DETAIL("decode image", path);
+    ImageData image;
+    image.path = path;
+    image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+    if (!image.pixels)
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+    return image;
+}
+
+// a 2D texture ready for upload: the compressed mip chain, or the decoded image if it stays uncompressed
+struct TextureData {
+    CompressedTexture compressed;
+    ImageData image;
+
+    bool IsCompressed() const
+    {
+        return !compressed.levels.empty();
+    }
+
+    // video memory the uploaded texture takes, including its mip chain
+    size_t GpuBytes() const
+    {
+        size_t bytes = 0;
+        for (const vector<unsigned char> &level : compressed.levels)
+            bytes += level.size();
+        if (!IsCompressed() && image.pixels)
+            bytes = (size_t)image.width * image.height * image.components * 4 / 3;
+        return bytes;
+    }
+};
+
+// CPU half of loading a 2D texture: reads the KTX cache of the image or, if it's missing or stale, decodes and
+// compresses the image and writes a new cache. Cone step maps are built from the decoded height map and cached
+// uncompressed, so they are only built once too. Safe to call from any thread.
+TextureData PrepareTexture(const string &path, TextureUsage usage = TEXTURE_COLOR)
+{
+    RG_PROFILE_ZONE_DETAIL("prepare texture", path);
+    TextureData texture;
+    if (ReadKtxCache(path, usage, texture.compressed))
+        return texture;
+
+    texture.image = DecodeImage(path);
+    if (usage == TEXTURE_CONE_MAP && texture.image.pixels)
+    {
+        unsigned char *cones = BuildConeMap(texture.image.pixels, texture.image.width, texture.image.height, texture.image.components);
+        stbi_image_free(texture.image.pixels);
+        texture.image.pixels = cones;
+        texture.image.components = 3;
+    }
+    if (CompressImage(texture.image.pixels, texture.image.width, texture.image.height, texture.image.components,
+                      usage, texture.compressed))
+    {
+        WriteKtxCache(path, usage, texture.compressed);
+        texture.image = ImageData();
+    }
+    return texture;
+}
+
+// uploads a decoded image as a mipmapped, repeating 2D texture; an image that failed to decode leaves the
+// texture without storage
+unsigned int UploadTexture(const ImageData &image)
+{
+    RG_PROFILE_ZONE_DETAIL("upload texture", image.path);
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    if (image.pixels)
+    {
+        GLenum format = GL_RED;
+        if (image.components == 1)
+            format = GL_RED;
+        else if (image.components == 3)
+            format = GL_RGB;
+        else if (image.components == 4)
+            format = GL_RGBA;
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, (GLint)format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    return textureID;
+}
+
+unsigned int UploadTexture(const TextureData &texture)
+{
+    if (texture.IsCompressed())
+        return UploadCompressedTexture(texture.compressed);
+    return UploadTexture(texture.image);
+}
+
+// uploads six decoded faces, in +X, -X, +Y, -Y, +Z, -Z order, as a cubemap
+unsigned int UploadCubemap(const vector<ImageData> &faces)
+{
+    RG_PROFILE_ZONE("upload cubemap");
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+    for (unsigned int i = 0; i < faces.size(); i++)
+    {
+        if (faces[i].pixels)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, faces[i].width, faces[i].height, 0, GL_RGB, GL_UNSIGNED_BYTE, faces[i].pixels);
+        else
+            std::cout << "Cubemap texture failed to load at path: " << faces[i].path << std::endl;
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    return textureID;
+}
+
+// synchronous helpers for code that doesn't go through the AssetLoader
+unsigned int LoadTexture(const string &path, TextureUsage usage = TEXTURE_COLOR)
+{
+    return UploadTexture(PrepareTexture(path, usage));
+}
+
+unsigned int LoadCubemap(const vector<string> &faces)
+{
+    vector<ImageData> images;
+    for (const string &face : faces)
+        images.push_back(DecodeImage(face));
+    return UploadCubemap(images);
+}
+#endif
@@ -0,0 +1,723 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <glad/glad.h>
+#include <rg/Profiler.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Block compression of textures at load time, with the result cached next to the source image as a KTX 1.1
+// file ("<image>.<usage>.ktx") holding the full mip chain. The encoders are simple single-pass ones (principal axis
+// endpoints, nearest palette index); they are meant to run once per image and then the cache is used.
+//
+//   color, opaque        BC7 (mode 6) if the driver has BPTC, otherwise BC1
+//   color with alpha     BC3
+//   normal map           BC5, x and y only; the shader reconstructs z
+//   height map           BC4, red only
+//   cone step map        uncompressed RG8, base level only (see cone_map.h); BC5 would move the depths and
+//                        could widen the cones past what is safe
+//   single channel       BC4, red only
+
+// S3TC and BPTC are extensions of GL 3.3 and not in the glad header; RGTC (BC4/BC5) is core
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+// what a texture is sampled as, which decides the compressed format
+enum TextureUsage {
+    TEXTURE_COLOR,
+    TEXTURE_NORMAL,
+    TEXTURE_HEIGHT,
+    // a height map turned into a cone step map for relief mapping when it's loaded
+    TEXTURE_CONE_MAP
+};
+
+// formats the driver can sample; filled in on the GL thread by DetectTextureCompression() before any worker
+// starts encoding, and only read afterwards
+struct TextureCompressionSupport {
+    bool s3tc = false;
+    bool bptc = false;
+    // set to false to upload every texture uncompressed, e.g. to compare quality
+    bool enabled = true;
+};
+
+TextureCompressionSupport& textureCompressionSupport()
+{
+    static TextureCompressionSupport support;
+    return support;
+}
+
+void DetectTextureCompression()
+{
+    TextureCompressionSupport &support = textureCompressionSupport();
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; i++)
+    {
+        const char *name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+            support.s3tc = true;
+        else if (strcmp(name, "GL_ARB_texture_compression_bptc") == 0)
+            support.bptc = true;
+    }
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 2))
+        support.bptc = true;
+}
+
+// the mip chain of a block compressed texture, or the base level of an uncompressed GL_RG8 one (cone step
+// maps), whose rows are padded to four bytes as in KTX
+struct CompressedTexture {
+    GLenum internalFormat = 0;
+    GLenum baseFormat = 0;
+    int width = 0;
+    int height = 0;
+    vector<vector<unsigned char>> levels; // level 0 first, down to 1x1
+};
+
+// ----------------------------------------------------------------------------------------------------------
+// block encoders; every block is 4x4 RGBA8 pixels in row order
+
+// principal axis of the block's colors through their mean, by power iteration on the covariance matrix.
+// channels selects how many of RGBA take part.
+void blockPrincipalAxis(const unsigned char block[16][4], int channels, float mean[4], float axis[4])
+{
+    for (int c = 0; c < 4; c++)
+    {
+        mean[c] = 0.0f;
+        for (int i = 0; i < 16; i++)
+            mean[c] += block[i][c];
+        mean[c] /= 16.0f;
+    }
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < channels; a++)
+            for (int b = 0; b < channels; b++)
+                covariance[a][b] += (block[i][a] - mean[a]) * (block[i][b] - mean[b]);
+
+    for (int c = 0; c < 4; c++)
+        axis[c] = c < channels ? 1.0f : 0.0f;
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int a = 0; a < channels; a++)
+        {
+            for (int b = 0; b < channels; b++)
+                next[a] += covariance[a][b] * axis[b];
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f)
+            break;
+        length = std::sqrt(length);
+        for (int a = 0; a < channels; a++)
+            axis[a] = next[a] / length;
+    }
+}
+
+// the two colors at the ends of the block's projection onto its principal axis
+void blockEndpoints(const unsigned char block[16][4], int channels, float low[4], float high[4])
+{
+    float mean[4], axis[4];
+    blockPrincipalAxis(block, channels, mean, axis);
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++)
+            t += (block[i][c] - mean[c]) * axis[c];
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    for (int c = 0; c < 4; c++)
+    {
+        low[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * minT));
+        high[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * maxT));
+    }
+}
+
+// BC1 color block (8 bytes); always uses the four color mode, since BC3 requires it
+void encodeBC1Block(const unsigned char block[16][4], unsigned char *out)
+{
+    float low[4], high[4];
+    blockEndpoints(block, 3, low, high);
+
+    auto pack565 = [](const float color[4]) -> uint16_t {
+        int r = (int)std::lround(color[0] * 31.0f / 255.0f);
+        int g = (int)std::lround(color[1] * 63.0f / 255.0f);
+        int b = (int)std::lround(color[2] * 31.0f / 255.0f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    };
+    uint16_t color0 = pack565(high);
+    uint16_t color1 = pack565(low);
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    int palette[4][3];
+    auto unpack565 = [](uint16_t color, int rgb[3]) {
+        int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    };
+    unpack565(color0, palette[0]);
+    unpack565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestError = 1 << 30;
+            for (int p = 0; p < 4; p++)
+            {
+                int error = 0;
+                for (int c = 0; c < 3; c++)
+                    error += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+    memcpy(out, &color0, 2);
+    memcpy(out + 2, &color1, 2);
+    memcpy(out + 4, &indices, 4);
+}
+
+// BC4 single channel block (8 bytes), also the alpha half of BC3 and each half of BC5
+void encodeBC4Block(const unsigned char block[16][4], int channel, unsigned char *out)
+{
+    int high = 0, low = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        high = std::max(high, (int)block[i][channel]);
+        low = std::min(low, (int)block[i][channel]);
+    }
+    // with high > low the palette is high, low and six values evenly spaced between them
+    uint64_t bits = (uint64_t)high | ((uint64_t)low << 8);
+    if (high != low)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int step = (int)std::lround((high - block[i][channel]) * 7.0f / (high - low));
+            int index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+            bits |= (uint64_t)index << (16 + 3 * i);
+        }
+    }
+    memcpy(out, &bits, 8);
+}
+
+// BC7 mode 6 block (16 bytes): a single RGBA line with 7 bit endpoints plus a p-bit each and 16 levels
+void encodeBC7Block(const unsigned char block[16][4], unsigned char *out)
+{
+    static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    float endpoints[2][4];
+    blockEndpoints(block, 4, endpoints[0], endpoints[1]);
+
+    // every endpoint is 7 bits per channel plus one p-bit shared by its channels; pick the p-bit that fits best
+    int quantized[2][4], pBits[2];
+    for (int e = 0; e < 2; e++)
+    {
+        float bestError = 1e30f;
+        for (int p = 0; p < 2; p++)
+        {
+            int candidate[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++)
+            {
+                candidate[c] = std::min(127, std::max(0, (int)std::lround((endpoints[e][c] - p) / 2.0f)));
+                float value = (float)((candidate[c] << 1) | p);
+                error += (value - endpoints[e][c]) * (value - endpoints[e][c]);
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                pBits[e] = p;
+                memcpy(quantized[e], candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    int palette[16][4];
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            int e0 = (quantized[0][c] << 1) | pBits[0];
+            int e1 = (quantized[1][c] << 1) | pBits[1];
+            palette[i][c] = ((64 - weights[i]) * e0 + weights[i] * e1 + 32) >> 6;
+        }
+    }
+    int indices[16];
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestError = 1 << 30;
+        for (int p = 0; p < 16; p++)
+        {
+            int error = 0;
+            for (int c = 0; c < 4; c++)
+                error += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+            if (error < bestError)
+            {
+                bestError = error;
+                best = p;
+            }
+        }
+        indices[i] = best;
+    }
+    // the first index is stored without its top bit, so it has to be in the lower half of the palette
+    if (indices[0] >= 8)
+    {
+        for (int c = 0; c < 4; c++)
+            std::swap(quantized[0][c], quantized[1][c]);
+        std::swap(pBits[0], pBits[1]);
+        for (int i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    memset(out, 0, 16);
+    unsigned int position = 0;
+    auto write = [&](unsigned int value, unsigned int bitCount) {
+        for (unsigned int i = 0; i < bitCount; i++, position++)
+            if ((value >> i) & 1)
+                out[position >> 3] |= (unsigned char)(1 << (position & 7));
+    };
+    write(1 << 6, 7); // mode 6: six zero bits and a one
+    for (int c = 0; c < 4; c++)
+    {
+        write(quantized[0][c], 7);
+        write(quantized[1][c], 7);
+    }
+    write(pBits[0], 1);
+    write(pBits[1], 1);
+    write(indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        write(indices[i], 4);
+}
+
+// ----------------------------------------------------------------------------------------------------------
+
+// bytes per 4x4 block of a compressed format
+unsigned int compressedBlockSize(GLenum internalFormat)
+{
+    return internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_RED_RGTC1 ? 8 : 16;
+}
+
+// compresses one mip level of an RGBA8 image
+vector<unsigned char> compressLevel(const vector<unsigned char> &rgba, int width, int height, GLenum internalFormat)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    unsigned int blockSize = compressedBlockSize(internalFormat);
+    vector<unsigned char> out(blocksX * blocksY * blockSize);
+    unsigned char *cursor = out.data();
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++, cursor += blockSize)
+        {
+            // levels smaller than a block repeat their edge pixels
+            unsigned char block[16][4];
+            for (int y = 0; y < 4; y++)
+            {
+                for (int x = 0; x < 4; x++)
+                {
+                    int sx = std::min(bx * 4 + x, width - 1), sy = std::min(by * 4 + y, height - 1);
+                    memcpy(block[y * 4 + x], &rgba[(sy * width + sx) * 4], 4);
+                }
+            }
+            switch (internalFormat)
+            {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+                encodeBC1Block(block, cursor);
+                break;
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                encodeBC4Block(block, 3, cursor);
+                encodeBC1Block(block, cursor + 8);
+                break;
+            case GL_COMPRESSED_RED_RGTC1:
+                encodeBC4Block(block, 0, cursor);
+                break;
+            case GL_COMPRESSED_RG_RGTC2:
+                encodeBC4Block(block, 0, cursor);
+                encodeBC4Block(block, 1, cursor + 8);
+                break;
+            case GL_COMPRESSED_RGBA_BPTC_UNORM:
+                encodeBC7Block(block, cursor);
+                break;
+            }
+        }
+    }
+    return out;
+}
+
+// 2x2 box filter down to the next mip level; normal maps are renormalized so averaging doesn't shorten them
+vector<unsigned char> downsampleLevel(const vector<unsigned char> &rgba, int width, int height, bool normalMap)
+{
+    int nextWidth = std::max(1, width / 2), nextHeight = std::max(1, height / 2);
+    vector<unsigned char> out(nextWidth * nextHeight * 4);
+    for (int y = 0; y < nextHeight; y++)
+    {
+        for (int x = 0; x < nextWidth; x++)
+        {
+            int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+            float sum[4];
+            for (int c = 0; c < 4; c++)
+                sum[c] = (rgba[(y0 * width + x0) * 4 + c] + rgba[(y0 * width + x1) * 4 + c]
+                        + rgba[(y1 * width + x0) * 4 + c] + rgba[(y1 * width + x1) * 4 + c]) / 4.0f;
+            if (normalMap)
+            {
+                float n[3], length = 0.0f;
+                for (int c = 0; c < 3; c++)
+                {
+                    n[c] = sum[c] / 127.5f - 1.0f;
+                    length += n[c] * n[c];
+                }
+                length = std::sqrt(length);
+                if (length > 1e-6f)
+                    for (int c = 0; c < 3; c++)
+                        sum[c] = (n[c] / length + 1.0f) * 127.5f;
+            }
+            for (int c = 0; c < 4; c++)
+                out[(y * nextWidth + x) * 4 + c] = (unsigned char)std::min(255.0f, std::max(0.0f, std::round(sum[c])));
+        }
+    }
+    return out;
+}
+
+// picks the compressed format for an image; returns false if it should stay uncompressed
+bool chooseCompressedFormat(const unsigned char *pixels, int width, int height, int components, TextureUsage usage,
+                            GLenum &internalFormat, GLenum &baseFormat)
+{
+    const TextureCompressionSupport &support = textureCompressionSupport();
+    if (!support.enabled)
+        return false;
+    if (usage == TEXTURE_NORMAL && components >= 3)
+    {
+        internalFormat = GL_COMPRESSED_RG_RGTC2;
+        baseFormat = GL_RG;
+        return true;
+    }
+    if (usage == TEXTURE_HEIGHT || components == 1)
+    {
+        internalFormat = GL_COMPRESSED_RED_RGTC1;
+        baseFormat = GL_RED;
+        return true;
+    }
+    bool alpha = false;
+    if (components == 4)
+        for (size_t i = 3; i < (size_t)width * height * 4 && !alpha; i += 4)
+            alpha = pixels[i] != 255;
+    if (alpha)
+    {
+        if (!support.s3tc)
+            return false;
+        internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        baseFormat = GL_RGBA;
+        return true;
+    }
+    if (support.bptc)
+    {
+        internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+        baseFormat = GL_RGBA;
+        return true;
+    }
+    if (!support.s3tc)
+        return false;
+    internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    baseFormat = GL_RGB;
+    return true;
+}
+
+// compresses a decoded image and its full mip chain; returns false if the image should stay uncompressed
+bool CompressImage(const unsigned char *pixels, int width, int height, int components, TextureUsage usage,
+                   CompressedTexture &texture)
+{
+    RG_PROFILE_ZONE("compress texture");
+    // the cone map's ratios are rounded down to stay conservative; only exact storage keeps them that way
+    if (usage == TEXTURE_CONE_MAP)
+    {
+        if (!pixels || components < 2)
+            return false;
+        size_t rowBytes = ((size_t)width * 2 + 3) & ~size_t(3);
+        texture.internalFormat = GL_RG8;
+        texture.baseFormat = GL_RG;
+        texture.width = width;
+        texture.height = height;
+        texture.levels.assign(1, vector<unsigned char>(rowBytes * height, 0));
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                for (int c = 0; c < 2; c++)
+                    texture.levels[0][y * rowBytes + x * 2 + c] = pixels[((size_t)y * width + x) * components + c];
+        return true;
+    }
+    GLenum internalFormat, baseFormat;
+    if (!pixels || !chooseCompressedFormat(pixels, width, height, components, usage, internalFormat, baseFormat))
+        return false;
+
+    // expand to RGBA8 so the encoders only deal with one layout; grey+alpha images become grey RGB
+    vector<unsigned char> rgba((size_t)width * height * 4);
+    for (size_t i = 0; i < (size_t)width * height; i++)
+    {
+        const unsigned char *source = pixels + i * components;
+        unsigned char *target = &rgba[i * 4];
+        if (components <= 2)
+        {
+            target[0] = target[1] = target[2] = source[0];
+            target[3] = components == 2 ? source[1] : 255;
+        }
+        else
+        {
+            target[0] = source[0];
+            target[1] = source[1];
+            target[2] = source[2];
+            target[3] = components == 4 ? source[3] : 255;
+        }
+    }
+
+    texture.internalFormat = internalFormat;
+    texture.baseFormat = baseFormat;
+    texture.width = width;
+    texture.height = height;
+    texture.levels.clear();
+    for (;;)
+    {
+        texture.levels.push_back(compressLevel(rgba, width, height, internalFormat));
+        if (width == 1 && height == 1)
+            break;
+        rgba = downsampleLevel(rgba, width, height, usage == TEXTURE_NORMAL);
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------
+// KTX 1.1 cache files. The source image's mtime and size and the usage are stored under a "rgSource"
+// key/value entry, and a cache whose entry doesn't match the image on disk is ignored.
+
+// one cache per usage, since an image loaded as two usages is encoded into two different textures
+string KtxCachePath(const string &sourcePath, TextureUsage usage)
+{
+    static const char *const usageNames[] = { "color", "normal", "height", "cone" };
+    return sourcePath + "." + usageNames[usage] + ".ktx";
+}
+
+// bump whenever the encoders change, so old caches get rebuilt
+const unsigned int KTX_CACHE_VERSION = 2;
+
+string ktxSourceStamp(const string &sourcePath, TextureUsage usage)
+{
+    struct stat st;
+    if (stat(sourcePath.c_str(), &st) != 0)
+        return "";
+    int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    std::ostringstream stamp;
+    stamp << KTX_CACHE_VERSION << ' ' << mtime << ' ' << (uint64_t)st.st_size << ' ' << (int)usage;
+    return stamp.str();
+}
+
+const unsigned char* ktxIdentifier()
+{
+    static const unsigned char identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+    return identifier;
+}
+
+struct KtxHeader {
+    unsigned char identifier[12];
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+const char* ktxSourceKey()
+{
+    return "rgSource";
+}
+
+// reads the cached mip chain of an image; returns false if there is none, it's stale, or its format can't be
+// sampled by this driver
+bool ReadKtxCache(const string &sourcePath, TextureUsage usage, CompressedTexture &texture)
+{
+    RG_PROFILE_ZONE_DETAIL("read ktx cache", sourcePath);
+    string stamp = ktxSourceStamp(sourcePath, usage);
+    std::ifstream in(KtxCachePath(sourcePath, usage), std::ios::binary);
+    if (stamp.empty() || !in)
+        return false;
+
+    KtxHeader header;
+    if (!in.read((char*)&header, sizeof(header)) || memcmp(header.identifier, ktxIdentifier(), 12) != 0
+        || header.endianness != 0x04030201 || header.numberOfFaces != 1
+        || header.glType != (header.glInternalFormat == GL_RG8 ? GL_UNSIGNED_BYTE : 0))
+        return false;
+
+    vector<char> keyValueData(header.bytesOfKeyValueData);
+    if (!in.read(keyValueData.data(), keyValueData.size()))
+        return false;
+    bool fresh = false;
+    for (size_t cursor = 0; cursor + 4 <= keyValueData.size();)
+    {
+        uint32_t length;
+        memcpy(&length, &keyValueData[cursor], 4);
+        cursor += 4;
+        if (cursor + length > keyValueData.size())
+            return false;
+        string entry(&keyValueData[cursor], length);
+        size_t separator = entry.find('\0');
+        if (separator != string::npos && entry.compare(0, separator, ktxSourceKey()) == 0)
+            fresh = entry.compare(separator + 1, string::npos, stamp + '\0') == 0;
+        cursor += (length + 3) & ~3u;
+    }
+    if (!fresh)
+        return false;
+
+    // a cache written on a machine with BPTC may not be usable on one without
+    const TextureCompressionSupport &support = textureCompressionSupport();
+    if ((!support.enabled && header.glInternalFormat != GL_RG8) || (header.glInternalFormat == GL_COMPRESSED_RGBA_BPTC_UNORM && !support.bptc)
+        || ((header.glInternalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || header.glInternalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) && !support.s3tc))
+        return false;
+
+    texture.internalFormat = header.glInternalFormat;
+    texture.baseFormat = header.glBaseInternalFormat;
+    texture.width = header.pixelWidth;
+    texture.height = header.pixelHeight;
+    texture.levels.resize(header.numberOfMipmapLevels);
+    for (vector<unsigned char> &level : texture.levels)
+    {
+        uint32_t imageSize;
+        if (!in.read((char*)&imageSize, 4))
+            return false;
+        level.resize(imageSize);
+        if (!in.read((char*)level.data(), imageSize))
+            return false;
+        // block sizes and the padded RG8 rows are multiples of four bytes, so there is never any mip padding
+    }
+    return true;
+}
+
+bool WriteKtxCache(const string &sourcePath, TextureUsage usage, const CompressedTexture &texture)
+{
+    string stamp = ktxSourceStamp(sourcePath, usage);
+    if (stamp.empty())
+        return false;
+
+    string entry = string(ktxSourceKey()) + '\0' + stamp + '\0';
+    uint32_t entryLength = entry.size();
+    entry.resize((entry.size() + 3) & ~size_t(3), '\0');
+
+    KtxHeader header;
+    memcpy(header.identifier, ktxIdentifier(), 12);
+    header.endianness = 0x04030201;
+    bool uncompressed = texture.internalFormat == GL_RG8;
+    header.glType = uncompressed ? GL_UNSIGNED_BYTE : 0;
+    header.glTypeSize = 1;
+    header.glFormat = uncompressed ? texture.baseFormat : 0;
+    header.glInternalFormat = texture.internalFormat;
+    header.glBaseInternalFormat = texture.baseFormat;
+    header.pixelWidth = texture.width;
+    header.pixelHeight = texture.height;
+    header.pixelDepth = 0;
+    header.numberOfArrayElements = 0;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = texture.levels.size();
+    header.bytesOfKeyValueData = 4 + entry.size();
+
+    // write to a temporary file first so a crash never leaves a truncated cache behind; it's named after the
+    // process and thread, so two loaders writing the same cache never write into one file
+    string cachePath = KtxCachePath(sourcePath, usage);
+    std::ostringstream tempName;
+    tempName << cachePath << '.' << getpid() << '-' << std::this_thread::get_id() << ".tmp";
+    string tempPath = tempName.str();
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        cout << "ERROR::TEXTURE_CACHE:: could not write " << tempPath << endl;
+        return false;
+    }
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)&entryLength, 4);
+    out.write(entry.data(), entry.size());
+    for (const vector<unsigned char> &level : texture.levels)
+    {
+        uint32_t imageSize = level.size();
+        out.write((const char*)&imageSize, 4);
+        out.write((const char*)level.data(), level.size());
+    }
+    out.close();
+    if (!out || rename(tempPath.c_str(), cachePath.c_str()) != 0)
+    {
+        cout << "ERROR::TEXTURE_CACHE:: could not write " << cachePath << endl;
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// uploads a compressed mip chain as a repeating 2D texture
+unsigned int UploadCompressedTexture(const CompressedTexture &texture)
+{
+    RG_PROFILE_ZONE("upload compressed texture");
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    int width = texture.width, height = texture.height;
+    for (unsigned int level = 0; level < texture.levels.size(); level++)
+    {
+        // the RG8 rows are padded to the default unpack alignment of four
+        if (texture.internalFormat == GL_RG8)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RG8, width, height, 0, GL_RG, GL_UNSIGNED_BYTE, texture.levels[level].data());
+        else
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat, width, height, 0,
+                                   texture.levels[level].size(), texture.levels[level].data());
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+#endif
@@ -0,0 +1,294 @@
+#ifndef PROJECT_BASE_BENCHMARK_H
+#define PROJECT_BASE_BENCHMARK_H
+
+#include <glm/glm.hpp>
+#include <rg/GpuProfiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// Camera state at one frame of a recorded path
+struct CameraKey {
+    unsigned int frame = 0;
+    glm::vec3 position = glm::vec3(0.0f);
+    float yaw = 0.0f;
+    float pitch = 0.0f;
+    float zoom = 45.0f;
+};
+
+// Camera path keyed by frame number, linearly interpolated in between. The text format has one key per line,
+//     frame  x y z  yaw pitch zoom
+// with '#' starting a comment, so paths can be written by hand as well as recorded.
+class CameraPath {
+public:
+    bool Load(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "ERROR::CAMERA_PATH:: could not read " << path << std::endl;
+            return false;
+        }
+        m_Keys.clear();
+        std::string line;
+        unsigned int lineNumber = 0;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            line = line.substr(0, line.find('#'));
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            std::istringstream fields(line);
+            CameraKey key;
+            if (!(fields >> key.frame >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch >> key.zoom)) {
+                std::cout << "ERROR::CAMERA_PATH:: " << path << ":" << lineNumber << ": expected frame x y z yaw pitch zoom" << std::endl;
+                return false;
+            }
+            Add(key);
+        }
+        if (m_Keys.empty()) {
+            std::cout << "ERROR::CAMERA_PATH:: " << path << " has no keys" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Save(const std::string& path) const {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            std::cout << "ERROR::CAMERA_PATH:: could not write " << path << std::endl;
+            return false;
+        }
+        out << "# frame  x y z  yaw pitch zoom\n";
+        for (const CameraKey& key : m_Keys) {
+            out << key.frame << "  " << key.position.x << ' ' << key.position.y << ' ' << key.position.z << "  "
+                << key.yaw << ' ' << key.pitch << ' ' << key.zoom << '\n';
+        }
+        return (bool)out;
+    }
+
+    // keys are kept sorted by frame; a key for a frame that already has one replaces it
+    void Add(const CameraKey& key) {
+        auto at = std::lower_bound(m_Keys.begin(), m_Keys.end(), key, [](const CameraKey& a, const CameraKey& b) {
+            return a.frame < b.frame;
+        });
+        if (at != m_Keys.end() && at->frame == key.frame) {
+            *at = key;
+        } else {
+            m_Keys.insert(at, key);
+        }
+    }
+
+    bool Empty() const {
+        return m_Keys.empty();
+    }
+
+    unsigned int LastFrame() const {
+        return m_Keys.empty() ? 0 : m_Keys.back().frame;
+    }
+
+    // camera at the given frame; yaw turns the short way round, frames outside the path hold its ends
+    CameraKey Sample(unsigned int frame) const {
+        if (m_Keys.empty()) {
+            return CameraKey();
+        }
+        if (frame <= m_Keys.front().frame) {
+            return m_Keys.front();
+        }
+        if (frame >= m_Keys.back().frame) {
+            return m_Keys.back();
+        }
+        auto next = std::upper_bound(m_Keys.begin(), m_Keys.end(), frame, [](unsigned int f, const CameraKey& key) {
+            return f < key.frame;
+        });
+        const CameraKey& a = *(next - 1);
+        const CameraKey& b = *next;
+        float t = float(frame - a.frame) / float(b.frame - a.frame);
+        float yawDelta = std::remainder(b.yaw - a.yaw, 360.0f);
+
+        CameraKey key;
+        key.frame = frame;
+        key.position = a.position + (b.position - a.position) * t;
+        key.yaw = a.yaw + yawDelta * t;
+        key.pitch = a.pitch + (b.pitch - a.pitch) * t;
+        key.zoom = a.zoom + (b.zoom - a.zoom) * t;
+        return key;
+    }
+
+private:
+    std::vector<CameraKey> m_Keys;
+};
+
+// Command line of the benchmark mode:
+//     --benchmark [camera path]   replay the path offscreen and write a report, then exit
+//     --frames N                  frames to render (default: the length of the path)
+//     --warmup N                  frames left out of the statistics (default 30)
+//     --timestep S                simulated seconds per frame (default 1/60)
+//     --output FILE               report file (default benchmark.json)
+//     --record FILE               interactive mode: save the flown camera path on exit
+//     --deferred                  render with the deferred path (F4) instead of the forward one
+//     --depth-prepass             lay down the depth of the opaque geometry before shading it (F5)
+//     --multi-draw                submit the opaque models as multi-draw indirect commands (F6)
+//     --gpu-culling               cull the instanced props in a compute pass (F7, needs GL 4.3)
+//     --no-hi-z                   leave the Hi-Z occlusion test out of the compute pass (F8)
+struct BenchmarkOptions {
+    bool enabled = false;
+    std::string cameraPath = "resources/benchmark/village.campath";
+    unsigned int frames = 0;
+    unsigned int warmup = 30;
+    float timestep = 1.0f / 60.0f;
+    std::string output = "benchmark.json";
+    std::string record;
+    bool deferred = false;
+    bool depthPrepass = false;
+    bool multiDraw = false;
+    bool gpuCulling = false;
+    bool noHiZ = false;
+
+    // false on an unknown or incomplete argument
+    bool Parse(int argc, char** argv) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0;
+            if (arg == "--benchmark") {
+                enabled = true;
+                if (hasValue) {
+                    cameraPath = argv[++i];
+                }
+            } else if (arg == "--frames" && hasValue) {
+                frames = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+            } else if (arg == "--warmup" && hasValue) {
+                warmup = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+            } else if (arg == "--timestep" && hasValue) {
+                timestep = std::strtof(argv[++i], nullptr);
+            } else if (arg == "--output" && hasValue) {
+                output = argv[++i];
+            } else if (arg == "--record" && hasValue) {
+                record = argv[++i];
+            } else if (arg == "--deferred") {
+                deferred = true;
+            } else if (arg == "--depth-prepass") {
+                depthPrepass = true;
+            } else if (arg == "--multi-draw") {
+                multiDraw = true;
+            } else if (arg == "--gpu-culling") {
+                gpuCulling = true;
+            } else if (arg == "--no-hi-z") {
+                noHiZ = true;
+            } else {
+                std::cout << "ERROR::BENCHMARK:: unknown or incomplete argument " << arg << std::endl;
+                return false;
+            }
+        }
+        if (timestep <= 0.0f) {
+            std::cout << "ERROR::BENCHMARK:: timestep has to be positive" << std::endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+// Frame times of a benchmark run and the JSON report built from them and the GPU pass timings
+class BenchmarkReport {
+public:
+    explicit BenchmarkReport(const BenchmarkOptions& options) : m_Options(options) {
+    }
+
+    // wall time of one frame, from the end of the previous one; warm-up frames are dropped
+    void AddFrame(uint64_t frame, double milliseconds) {
+        if (frame >= m_Options.warmup) {
+            m_FrameTimes.push_back(milliseconds);
+        }
+    }
+
+    bool Write(const std::string& renderer, int width, int height, const GpuProfiler& profiler) const {
+        std::ofstream out(m_Options.output, std::ios::trunc);
+        if (!out) {
+            std::cout << "ERROR::BENCHMARK:: could not write " << m_Options.output << std::endl;
+            return false;
+        }
+        out << std::fixed << std::setprecision(4);
+        out << "{\n";
+        out << "  \"renderer\": \"" << escape(renderer) << "\",\n";
+        out << "  \"resolution\": [" << width << ", " << height << "],\n";
+        out << "  \"camera_path\": \"" << escape(m_Options.cameraPath) << "\",\n";
+        out << "  \"timestep\": " << m_Options.timestep << ",\n";
+        out << "  \"warmup_frames\": " << m_Options.warmup << ",\n";
+        out << "  \"measured_frames\": " << m_FrameTimes.size() << ",\n";
+        out << "  \"frame_time_ms\": ";
+        writeStatistics(out, m_FrameTimes);
+        out << ",\n  \"gpu_pass_ms\": {";
+        for (unsigned int pass = 0; pass < profiler.PassCount(); ++pass) {
+            std::vector<double> times;
+            for (const GpuProfiler::Sample& sample : profiler.Samples(pass)) {
+                if (sample.frame >= m_Options.warmup) {
+                    times.push_back(sample.milliseconds);
+                }
+            }
+            out << (pass == 0 ? "\n" : ",\n") << "    \"" << escape(profiler.Name(pass)) << "\": ";
+            writeStatistics(out, times);
+        }
+        out << "\n  },\n";
+        out << "  \"dropped_gpu_results\": " << profiler.Dropped() << "\n}\n";
+        return (bool)out;
+    }
+
+    // one line summary for the console
+    void Print(std::ostream& out) const {
+        std::vector<double> sorted = m_FrameTimes;
+        std::sort(sorted.begin(), sorted.end());
+        out << "Benchmark: " << sorted.size() << " frames, p50 " << percentile(sorted, 50.0) << " ms, p99 "
+            << percentile(sorted, 99.0) << " ms, written to " << m_Options.output << std::endl;
+    }
+
+private:
+    const BenchmarkOptions& m_Options;
+    std::vector<double> m_FrameTimes;
+
+    // nearest-rank percentile of sorted values
+    static double percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+        return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+
+    static void writeStatistics(std::ostream& out, std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        double sum = 0.0;
+        for (double value : values) {
+            sum += value;
+        }
+        out << "{\"count\": " << values.size()
+            << ", \"mean\": " << (values.empty() ? 0.0 : sum / values.size())
+            << ", \"min\": " << (values.empty() ? 0.0 : values.front())
+            << ", \"p50\": " << percentile(values, 50.0)
+            << ", \"p90\": " << percentile(values, 90.0)
+            << ", \"p95\": " << percentile(values, 95.0)
+            << ", \"p99\": " << percentile(values, 99.0)
+            << ", \"max\": " << (values.empty() ? 0.0 : values.back()) << "}";
+    }
+
+    static std::string escape(const std::string& value) {
+        std::string escaped;
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += (unsigned char)c < 0x20 ? ' ' : c;
+        }
+        return escaped;
+    }
+};
+
+};
+#endif //PROJECT_BASE_BENCHMARK_H
@@ -6,20 +6,114 @@
 #define PROJECT_BASE_ERROR_H
 
 #include <iostream>
+#include <cstring>
+#include <string>
 #include <glad/glad.h>
 
+// GL errors are reported through KHR_debug (core in 4.3) or ARB_debug_output where the driver has either: the
+// driver calls back with a message instead of the application polling glGetError, which on many drivers waits
+// for the GPU. enableGLDebugOutput installs the callback once the context is current.
+//
+// With RG_GL_DEBUG defined (Debug builds) the output is synchronous, so a message arrives inside the GL call
+// that caused it, and GLCALL names that call and traps on an error; without a debug extension GLCALL falls back
+// to glGetError. Otherwise GLCALL is the bare call and messages arrive asynchronously, without a call site.
+
 #define LOG(stream) stream << "[" << __FILE__ << ", " << __func__ << ", " << __LINE__ << "] "
 #define BREAK_IF_FALSE(x) if (!(x)) __builtin_trap()
 #define ASSERT(x, msg) do { if (!(x)) { std::cerr << msg << '\n'; BREAK_IF_FALSE(false); } } while(0)
+#ifdef RG_GL_DEBUG
 #define GLCALL(x) \
-do{ rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+do{ rg::GLCallSite glCallSite(__FILE__, __LINE__, #x); x; BREAK_IF_FALSE(glCallSite.succeeded()); } while (0)
+#else
+#define GLCALL(x) do { x; } while (0)
+#endif
+
+// KHR_debug tokens; the loader only has GL 3.3 core
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_SOURCE_OTHER 0x824B
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_OTHER 0x8251
+#define GL_DEBUG_TYPE_MARKER 0x8268
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+#endif
 
 namespace rg {
 
-    
+
 void clearAllOpenGlErrors();
 const char* openGLErrorToString(GLenum error);
 bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call);
+bool enableGLDebugOutput(GLADloadproc load, GLenum minimumSeverity = GL_DEBUG_SEVERITY_MEDIUM);
+void setGLDebugMinimumSeverity(GLenum severity);
+
+    // state of the debug output channel, shared by the callback and GLCALL
+    struct GLDebugOutput {
+        typedef void (APIENTRY *MessageCallbackProc)(GLDEBUGPROC callback, const void* userParam);
+        typedef void (APIENTRY *MessageControlProc)(GLenum source, GLenum type, GLenum severity, GLsizei count,
+                                                    const GLuint* ids, GLboolean enabled);
+        MessageControlProc messageControl = nullptr;
+        // KHR_debug or GL 4.3, as opposed to ARB_debug_output, which has no notifications
+        bool khr = false;
+        bool active = false;
+        GLenum minimumSeverity = GL_DEBUG_SEVERITY_MEDIUM;
+    };
+
+    GLDebugOutput& glDebugOutput() {
+        static GLDebugOutput output;
+        return output;
+    }
+
+    // the GL call GLCALL is running on this thread, so the synchronous callback can name it
+    struct GLCallSiteInfo {
+        const char* file = nullptr;
+        int line = 0;
+        const char* call = nullptr;
+        bool failed = false;
+    };
+
+    GLCallSiteInfo& currentGLCallSite() {
+        thread_local GLCallSiteInfo site;
+        return site;
+    }
+
+    class GLCallSite {
+    public:
+        GLCallSite(const char* file, int line, const char* call) {
+            GLCallSiteInfo& site = currentGLCallSite();
+            site.file = file;
+            site.line = line;
+            site.call = call;
+            site.failed = false;
+            if (!glDebugOutput().active) {
+                clearAllOpenGlErrors();
+            }
+        }
+        ~GLCallSite() {
+            currentGLCallSite() = GLCallSiteInfo();
+        }
+        bool succeeded() const {
+            GLCallSiteInfo& site = currentGLCallSite();
+            if (glDebugOutput().active) {
+                return !site.failed;
+            }
+            return wasPreviousOpenGLCallSuccessful(site.file, site.line, site.call);
+        }
+    };
 
     void clearAllOpenGlErrors() {
         while (glGetError() != GL_NO_ERROR) {
@@ -32,6 +126,7 @@ bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* cal
             case GL_INVALID_ENUM: return "GL_INVALID_ENUM";
             case GL_INVALID_VALUE: return "GL_INVALID_VALUE";
             case GL_INVALID_OPERATION: return "GL_INVALID_OPERATION";
+            case GL_INVALID_FRAMEBUFFER_OPERATION: return "GL_INVALID_FRAMEBUFFER_OPERATION";
             case GL_OUT_OF_MEMORY: return "GL_OUT_OF_MEMORY";
         }
         ASSERT(false, "Passed something that is not an error code");
@@ -50,5 +145,125 @@ bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* cal
         return success;
     }
 
+    // higher is more severe
+    int glDebugSeverityRank(GLenum severity) {
+        switch (severity) {
+            case GL_DEBUG_SEVERITY_HIGH: return 3;
+            case GL_DEBUG_SEVERITY_MEDIUM: return 2;
+            case GL_DEBUG_SEVERITY_LOW: return 1;
+        }
+        return 0;
+    }
+    const char* glDebugSeverityToString(GLenum severity) {
+        switch (severity) {
+            case GL_DEBUG_SEVERITY_HIGH: return "high";
+            case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+            case GL_DEBUG_SEVERITY_LOW: return "low";
+        }
+        return "notification";
+    }
+    const char* glDebugSourceToString(GLenum source) {
+        switch (source) {
+            case GL_DEBUG_SOURCE_API: return "api";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+            case GL_DEBUG_SOURCE_APPLICATION: return "application";
+        }
+        return "other";
+    }
+    const char* glDebugTypeToString(GLenum type) {
+        switch (type) {
+            case GL_DEBUG_TYPE_ERROR: return "error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated behavior";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+            case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+            case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+            case GL_DEBUG_TYPE_MARKER: return "marker";
+        }
+        return "other";
+    }
+
+    void APIENTRY glDebugMessage(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                 const GLchar* message, const void* userParam) {
+        // the driver filters too, but ARB_debug_output can't be told to drop everything below a severity
+        if (glDebugSeverityRank(severity) < glDebugSeverityRank(glDebugOutput().minimumSeverity)) {
+            return;
+        }
+        std::cerr << "[OpenGL " << glDebugTypeToString(type) << "] " << glDebugSeverityToString(severity)
+        << ", " << glDebugSourceToString(source) << ", id " << id << ": " << message << '\n';
+        GLCallSiteInfo& site = currentGLCallSite();
+        if (site.call != nullptr) {
+            std::cerr << "File: " << site.file
+            << "\nLine: " << site.line
+            << "\nCall: " << site.call << '\n';
+            if (type == GL_DEBUG_TYPE_ERROR) {
+                site.failed = true;
+            }
+        }
+        std::cerr << '\n';
+    }
+
+    // Installs the debug message callback if the context has KHR_debug, GL 4.3 or ARB_debug_output, and returns
+    // whether it did. ARB_debug_output and, on some drivers, KHR_debug only report anything in a debug context.
+    bool enableGLDebugOutput(GLADloadproc load, GLenum minimumSeverity) {
+        GLint major = 0, minor = 0, extensionCount = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        bool khr = major > 4 || (major == 4 && minor >= 3);
+        bool arb = false;
+        for (GLint i = 0; i < extensionCount; ++i) {
+            const char* extension = (const char*) glGetStringi(GL_EXTENSIONS, i);
+            khr = khr || std::strcmp(extension, "GL_KHR_debug") == 0;
+            arb = arb || std::strcmp(extension, "GL_ARB_debug_output") == 0;
+        }
+        if (!khr && !arb) {
+            return false;
+        }
+
+        std::string suffix = khr ? "" : "ARB";
+        GLDebugOutput::MessageCallbackProc messageCallback =
+                (GLDebugOutput::MessageCallbackProc) load(("glDebugMessageCallback" + suffix).c_str());
+        GLDebugOutput& output = glDebugOutput();
+        output.messageControl = (GLDebugOutput::MessageControlProc) load(("glDebugMessageControl" + suffix).c_str());
+        if (messageCallback == nullptr || output.messageControl == nullptr) {
+            return false;
+        }
+        output.khr = khr;
+
+        if (khr) {
+            glEnable(GL_DEBUG_OUTPUT);
+        }
+#ifdef RG_GL_DEBUG
+        // messages arrive inside the call that caused them, at the cost of the driver's threading
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#else
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#endif
+        messageCallback(glDebugMessage, nullptr);
+        setGLDebugMinimumSeverity(minimumSeverity);
+        output.active = true;
+        return true;
+    }
+
+    // messages less severe than this are dropped by the driver where it can, and by the callback otherwise
+    void setGLDebugMinimumSeverity(GLenum severity) {
+        GLDebugOutput& output = glDebugOutput();
+        output.minimumSeverity = severity;
+        if (output.messageControl == nullptr) {
+            return;
+        }
+        const GLenum severities[] = {GL_DEBUG_SEVERITY_HIGH, GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_LOW,
+                                     GL_DEBUG_SEVERITY_NOTIFICATION};
+        for (GLenum s : severities) {
+            if (s == GL_DEBUG_SEVERITY_NOTIFICATION && !output.khr) {
+                continue;
+            }
+            bool enabled = glDebugSeverityRank(s) >= glDebugSeverityRank(severity);
+            output.messageControl(GL_DONT_CARE, GL_DONT_CARE, s, 0, nullptr, enabled ? GL_TRUE : GL_FALSE);
+        }
+    }
+
 };
 #endif //PROJECT_BASE_ERROR_H
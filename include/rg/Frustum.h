@@ -0,0 +1,212 @@
+#ifndef PROJECT_BASE_FRUSTUM_H
+#define PROJECT_BASE_FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RG_FRUSTUM_SSE 1
+#endif
+
+namespace rg {
+
+// Axis-aligned box and enclosing sphere of a piece of geometry, in its own space
+struct Bounds {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    // box of the positions and the sphere around its center that reaches the farthest of them
+    template<typename Vertex>
+    static Bounds Of(const Vertex* vertices, unsigned int count) {
+        Bounds bounds;
+        if (count == 0) {
+            return bounds;
+        }
+        bounds.min = bounds.max = vertices[0].Position;
+        for (unsigned int i = 1; i < count; ++i) {
+            bounds.min = glm::min(bounds.min, vertices[i].Position);
+            bounds.max = glm::max(bounds.max, vertices[i].Position);
+        }
+        bounds.center = (bounds.min + bounds.max) * 0.5f;
+        float radius2 = 0.0f;
+        for (unsigned int i = 0; i < count; ++i) {
+            glm::vec3 offset = vertices[i].Position - bounds.center;
+            radius2 = std::max(radius2, glm::dot(offset, offset));
+        }
+        bounds.radius = std::sqrt(radius2);
+        return bounds;
+    }
+
+    // smallest box holding both, with the sphere around it
+    static Bounds Union(const Bounds& a, const Bounds& b) {
+        Bounds bounds;
+        bounds.min = glm::min(a.min, b.min);
+        bounds.max = glm::max(a.max, b.max);
+        bounds.center = (bounds.min + bounds.max) * 0.5f;
+        bounds.radius = glm::length(bounds.max - bounds.center);
+        return bounds;
+    }
+};
+
+struct Sphere {
+    glm::vec3 center;
+    float radius;
+};
+
+// world-space sphere of bounds placed with the given model matrix; the radius grows with the largest scale
+// along any axis, so it stays conservative for non-uniform scales
+inline Sphere TransformSphere(const glm::vec3& center, float radius, const glm::mat4& model) {
+    float scale2 = std::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+                            std::max(glm::dot(glm::vec3(model[1]), glm::vec3(model[1])),
+                                     glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))));
+    return Sphere{glm::vec3(model * glm::vec4(center, 1.0f)), radius * std::sqrt(scale2)};
+}
+
+inline Sphere TransformSphere(const Bounds& bounds, const glm::mat4& model) {
+    return TransformSphere(bounds.center, bounds.radius, model);
+}
+
+// The six clip planes of a view-projection matrix (Gribb/Hartmann), normalized and facing inwards, so the
+// signed distance of a point to each of them is positive inside the frustum.
+class Frustum {
+public:
+    enum { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+
+    Frustum() = default;
+
+    explicit Frustum(const glm::mat4& viewProjection) {
+        // GLM matrices are column major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+        glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        m_Planes[PLANE_LEFT] = row3 + row0;
+        m_Planes[PLANE_RIGHT] = row3 - row0;
+        m_Planes[PLANE_BOTTOM] = row3 + row1;
+        m_Planes[PLANE_TOP] = row3 - row1;
+        m_Planes[PLANE_NEAR] = row3 + row2;
+        m_Planes[PLANE_FAR] = row3 - row2;
+        for (glm::vec4& plane : m_Planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+    }
+
+    // (normal, distance) of a plane
+    const glm::vec4& Plane(int index) const {
+        return m_Planes[index];
+    }
+
+    // false only if the sphere is entirely outside one of the planes
+    bool Intersects(const Sphere& sphere) const {
+        for (const glm::vec4& plane : m_Planes) {
+            if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // box test against the corner farthest along each plane normal
+    bool Intersects(const glm::vec3& min, const glm::vec3& max) const {
+        for (const glm::vec4& plane : m_Planes) {
+            glm::vec3 farthest(plane.x >= 0.0f ? max.x : min.x,
+                               plane.y >= 0.0f ? max.y : min.y,
+                               plane.z >= 0.0f ? max.z : min.z);
+            if (glm::dot(glm::vec3(plane), farthest) + plane.w < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    glm::vec4 m_Planes[PLANE_COUNT];
+};
+
+// World-space bounding spheres stored as separate x, y, z and radius arrays, so the frustum test runs on
+// four spheres at a time. The arrays are padded to a multiple of four with spheres that never pass.
+class SphereSet {
+public:
+    void Clear() {
+        m_X.clear();
+        m_Y.clear();
+        m_Z.clear();
+        m_Radius.clear();
+        m_Count = 0;
+    }
+
+    void Add(const Sphere& sphere) {
+        // overwrite the padding of the last block or start a new one
+        if (m_Count == m_X.size()) {
+            m_X.resize(m_Count + 4, 0.0f);
+            m_Y.resize(m_Count + 4, 0.0f);
+            m_Z.resize(m_Count + 4, 0.0f);
+            m_Radius.resize(m_Count + 4, -FLT_MAX);
+        }
+        m_X[m_Count] = sphere.center.x;
+        m_Y[m_Count] = sphere.center.y;
+        m_Z[m_Count] = sphere.center.z;
+        m_Radius[m_Count] = sphere.radius;
+        m_Count++;
+    }
+
+    size_t Size() const {
+        return m_Count;
+    }
+
+    // replaces visible with the indices of the spheres that intersect the frustum, in ascending order
+    void Cull(const Frustum& frustum, std::vector<uint32_t>& visible) const {
+        visible.clear();
+#ifdef RG_FRUSTUM_SSE
+        __m128 planeX[Frustum::PLANE_COUNT], planeY[Frustum::PLANE_COUNT];
+        __m128 planeZ[Frustum::PLANE_COUNT], planeW[Frustum::PLANE_COUNT];
+        for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+            const glm::vec4& plane = frustum.Plane(p);
+            planeX[p] = _mm_set1_ps(plane.x);
+            planeY[p] = _mm_set1_ps(plane.y);
+            planeZ[p] = _mm_set1_ps(plane.z);
+            planeW[p] = _mm_set1_ps(plane.w);
+        }
+        const __m128 zero = _mm_setzero_ps();
+        for (size_t i = 0; i < m_X.size(); i += 4) {
+            __m128 x = _mm_loadu_ps(&m_X[i]);
+            __m128 y = _mm_loadu_ps(&m_Y[i]);
+            __m128 z = _mm_loadu_ps(&m_Z[i]);
+            __m128 r = _mm_loadu_ps(&m_Radius[i]);
+            __m128 inside = _mm_cmpeq_ps(zero, zero);
+            for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+                                             _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+            }
+            int mask = _mm_movemask_ps(inside);
+            for (int lane = 0; mask != 0; ++lane, mask >>= 1) {
+                if (mask & 1) {
+                    visible.push_back((uint32_t)(i + lane));
+                }
+            }
+        }
+#else
+        for (size_t i = 0; i < m_Count; ++i) {
+            if (frustum.Intersects(Sphere{glm::vec3(m_X[i], m_Y[i], m_Z[i]), m_Radius[i]})) {
+                visible.push_back((uint32_t)i);
+            }
+        }
+#endif
+    }
+
+private:
+    std::vector<float> m_X, m_Y, m_Z, m_Radius;
+    size_t m_Count = 0;
+};
+
+};
+#endif //PROJECT_BASE_FRUSTUM_H
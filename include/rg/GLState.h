@@ -0,0 +1,119 @@
+#ifndef PROJECT_BASE_GLSTATE_H
+#define PROJECT_BASE_GLSTATE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace rg {
+
+// Shadow copy of the GL binding state that the draw paths touch: the current program, the vertex array and
+// the texture bound to each unit. Binds that wouldn't change anything are skipped.
+//
+// The cache only stays correct if those binds go through it. Code that binds behind its back (resource
+// uploads, framebuffer setup) has to be followed by Invalidate(); the render loop invalidates once at the
+// start of every frame.
+class GLState {
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+
+    GLState() {
+        Invalidate();
+    }
+
+    // forgets every cached binding, so the next bind of each kind always reaches GL
+    void Invalidate() {
+        m_Program = UNKNOWN;
+        m_VertexArray = UNKNOWN;
+        m_ActiveUnit = UNKNOWN;
+        for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; ++unit) {
+            for (unsigned int target = 0; target < TARGET_COUNT; ++target) {
+                m_Textures[unit][target] = UNKNOWN;
+            }
+        }
+    }
+
+    // sampler uniforms are program state that outlives a frame, so they are only forgotten on request
+    void InvalidateSamplers() {
+        m_SamplerUnits.clear();
+    }
+
+    void UseProgram(GLuint program) {
+        if (m_Program != program) {
+            glUseProgram(program);
+            m_Program = program;
+        }
+    }
+
+    void BindVertexArray(GLuint vertexArray) {
+        if (m_VertexArray != vertexArray) {
+            glBindVertexArray(vertexArray);
+            m_VertexArray = vertexArray;
+        }
+    }
+
+    // binds the texture to the unit (0 based, not GL_TEXTUREi); targets the cache doesn't track are bound directly
+    void BindTexture(unsigned int unit, GLenum target, GLuint texture) {
+        unsigned int slot = targetSlot(target);
+        if (unit >= MAX_TEXTURE_UNITS || slot == TARGET_COUNT) {
+            activeUnit(unit);
+            glBindTexture(target, texture);
+            return;
+        }
+        if (m_Textures[unit][slot] != texture) {
+            activeUnit(unit);
+            glBindTexture(target, texture);
+            m_Textures[unit][slot] = texture;
+        }
+    }
+
+    // points a sampler uniform of the program in use at a texture unit
+    void SetSamplerUnit(GLuint program, GLint location, int unit) {
+        if (location < 0) {
+            return;
+        }
+        uint64_t key = ((uint64_t)program << 32) | (uint32_t)location;
+        auto found = m_SamplerUnits.find(key);
+        if (found != m_SamplerUnits.end() && found->second == unit) {
+            return;
+        }
+        glUniform1i(location, unit);
+        m_SamplerUnits[key] = unit;
+    }
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+    static const unsigned int TARGET_COUNT = 3;
+
+    GLuint m_Program;
+    GLuint m_VertexArray;
+    GLuint m_ActiveUnit;
+    GLuint m_Textures[MAX_TEXTURE_UNITS][TARGET_COUNT];
+    std::unordered_map<uint64_t, int> m_SamplerUnits;
+
+    static unsigned int targetSlot(GLenum target) {
+        switch (target) {
+            case GL_TEXTURE_2D: return 0;
+            case GL_TEXTURE_CUBE_MAP: return 1;
+            case GL_TEXTURE_BUFFER: return 2;
+        }
+        return TARGET_COUNT;
+    }
+
+    void activeUnit(unsigned int unit) {
+        if (m_ActiveUnit != unit) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            m_ActiveUnit = unit;
+        }
+    }
+};
+
+// the cache for the one GL context of the application
+GLState& State() {
+    static GLState state;
+    return state;
+}
+
+};
+#endif //PROJECT_BASE_GLSTATE_H
@@ -0,0 +1,285 @@
+#ifndef PROJECT_BASE_GEOMETRYPOOL_H
+#define PROJECT_BASE_GEOMETRYPOOL_H
+
+#include <glad/glad.h>
+#include <rg/GLState.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+namespace rg {
+
+// First fit allocator over a range of units (vertices or bytes). The free blocks are kept sorted by offset, so
+// a freed block merges with its free neighbours.
+class FreeListAllocator {
+public:
+    static const uint32_t INVALID = 0xFFFFFFFFu;
+
+    // offset of a block of the given size, or INVALID if no free block is large enough
+    uint32_t Allocate(uint32_t size) {
+        for (auto block = m_Free.begin(); block != m_Free.end(); ++block) {
+            if (block->second < size) {
+                continue;
+            }
+            uint32_t offset = block->first;
+            uint32_t remaining = block->second - size;
+            m_Free.erase(block);
+            if (remaining > 0) {
+                m_Free[offset + size] = remaining;
+            }
+            m_FreeUnits -= size;
+            return offset;
+        }
+        return INVALID;
+    }
+
+    void Free(uint32_t offset, uint32_t size) {
+        if (size == 0) {
+            return;
+        }
+        m_FreeUnits += size;
+        auto next = m_Free.lower_bound(offset);
+        if (next != m_Free.end() && offset + size == next->first) {
+            size += next->second;
+            next = m_Free.erase(next);
+        }
+        if (next != m_Free.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                previous->second += size;
+                return;
+            }
+        }
+        m_Free[offset] = size;
+    }
+
+    // extends the range to the new capacity, the added units being free
+    void Grow(uint32_t capacity) {
+        uint32_t added = capacity - m_Capacity;
+        uint32_t offset = m_Capacity;
+        m_Capacity = capacity;
+        Free(offset, added);
+    }
+
+    // after compaction: the first used units are taken and the rest up to the capacity is one free block
+    void Reset(uint32_t used) {
+        m_Free.clear();
+        m_FreeUnits = 0;
+        Free(used, m_Capacity - used);
+    }
+
+    uint32_t Capacity() const {
+        return m_Capacity;
+    }
+
+    uint32_t FreeUnits() const {
+        return m_FreeUnits;
+    }
+
+    uint32_t LargestFree() const {
+        uint32_t largest = 0;
+        for (const auto& block : m_Free) {
+            largest = std::max(largest, block.second);
+        }
+        return largest;
+    }
+
+private:
+    std::map<uint32_t, uint32_t> m_Free; // offset -> size
+    uint32_t m_Capacity = 0;
+    uint32_t m_FreeUnits = 0;
+};
+
+// where an allocation of a GeometryPool currently lives; moves when the pool is compacted
+struct GeometryRange {
+    uint32_t baseVertex = 0;  // first vertex, added to every index by the base vertex draws
+    uint32_t vertexCount = 0;
+    uint32_t indexOffset = 0; // in bytes, a multiple of 4 so 16 and 32 bit indices can share the buffer
+    uint32_t indexBytes = 0;  // as allocated, rounded up to 4
+    bool live = false;
+};
+
+// One vertex buffer and one index buffer for every mesh of one vertex format, with one VAO over them. Meshes get
+// a range of each; indices are relative to the mesh's first vertex and drawn with glDrawElementsBaseVertex, so
+// drawing any number of meshes needs no VAO switch, and ranges can move without rewriting indices.
+//
+// When an allocation doesn't fit, both buffers are regrown to at least twice their size on the GPU. When frees
+// leave the space fragmented, the live ranges are copied together to the front; allocations are handles, so the
+// caller looks its range up at draw time (Range(), an array index) and never sees the move.
+class GeometryPool {
+public:
+    // setupAttributes declares the vertex attributes; it is called with the VAO and the vertex buffer bound, also
+    // whenever the vertex buffer is replaced
+    GeometryPool(uint32_t vertexStride, std::function<void()> setupAttributes, uint32_t vertexCapacity = 1 << 16,
+                 uint32_t indexCapacity = 1 << 20)
+            : m_VertexStride(vertexStride), m_SetupAttributes(std::move(setupAttributes)) {
+        glGenVertexArrays(1, &m_VertexArray);
+        resize(vertexCapacity, indexCapacity);
+    }
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    ~GeometryPool() {
+        glDeleteVertexArrays(1, &m_VertexArray);
+        glDeleteBuffers(1, &m_VertexBuffer);
+        glDeleteBuffers(1, &m_IndexBuffer);
+        State().Invalidate();
+    }
+
+    // copies the vertices and indices into the pool and returns the handle of their ranges
+    uint32_t Allocate(const void* vertices, uint32_t vertexCount, const void* indices, uint32_t indexBytes) {
+        GeometryRange range;
+        range.vertexCount = vertexCount;
+        range.indexBytes = (indexBytes + 3) & ~3u;
+        range.live = true;
+        range.baseVertex = m_Vertices.Allocate(vertexCount);
+        range.indexOffset = m_Indices.Allocate(range.indexBytes);
+        if (range.baseVertex == FreeListAllocator::INVALID || range.indexOffset == FreeListAllocator::INVALID) {
+            if (range.baseVertex != FreeListAllocator::INVALID) {
+                m_Vertices.Free(range.baseVertex, vertexCount);
+            }
+            if (range.indexOffset != FreeListAllocator::INVALID) {
+                m_Indices.Free(range.indexOffset, range.indexBytes);
+            }
+            resize(std::max(m_Vertices.Capacity() * 2, m_Vertices.Capacity() + vertexCount),
+                   std::max(m_Indices.Capacity() * 2, m_Indices.Capacity() + range.indexBytes));
+            range.baseVertex = m_Vertices.Allocate(vertexCount);
+            range.indexOffset = m_Indices.Allocate(range.indexBytes);
+        }
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_VertexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr) range.baseVertex * m_VertexStride, (GLsizeiptr) vertexCount * m_VertexStride, vertices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_IndexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, range.indexOffset, indexBytes, indices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        uint32_t handle;
+        if (!m_FreeHandles.empty()) {
+            handle = m_FreeHandles.back();
+            m_FreeHandles.pop_back();
+            m_Ranges[handle] = range;
+        } else {
+            handle = m_Ranges.size();
+            m_Ranges.push_back(range);
+        }
+        return handle;
+    }
+
+    void Free(uint32_t handle) {
+        GeometryRange& range = m_Ranges[handle];
+        if (!range.live) {
+            return;
+        }
+        m_Vertices.Free(range.baseVertex, range.vertexCount);
+        m_Indices.Free(range.indexOffset, range.indexBytes);
+        range.live = false;
+        m_FreeHandles.push_back(handle);
+        if (fragmented(m_Vertices) || fragmented(m_Indices)) {
+            Defragment();
+        }
+    }
+
+    // moves the live ranges together to the front of the buffers
+    void Defragment() {
+        std::vector<uint32_t> order;
+        for (uint32_t handle = 0; handle < m_Ranges.size(); ++handle) {
+            if (m_Ranges[handle].live) {
+                order.push_back(handle);
+            }
+        }
+        GLuint vertexBuffer = createBuffer(m_Vertices.Capacity() * m_VertexStride);
+        GLuint indexBuffer = createBuffer(m_Indices.Capacity());
+        uint32_t vertexEnd = 0, indexEnd = 0;
+        for (uint32_t handle : order) {
+            GeometryRange& range = m_Ranges[handle];
+            copy(m_VertexBuffer, vertexBuffer, (GLintptr) range.baseVertex * m_VertexStride, (GLintptr) vertexEnd * m_VertexStride,
+                 (GLsizeiptr) range.vertexCount * m_VertexStride);
+            copy(m_IndexBuffer, indexBuffer, range.indexOffset, indexEnd, range.indexBytes);
+            range.baseVertex = vertexEnd;
+            range.indexOffset = indexEnd;
+            vertexEnd += range.vertexCount;
+            indexEnd += range.indexBytes;
+        }
+        replaceBuffers(vertexBuffer, indexBuffer);
+        m_Vertices.Reset(vertexEnd);
+        m_Indices.Reset(indexEnd);
+    }
+
+    const GeometryRange& Range(uint32_t handle) const {
+        return m_Ranges[handle];
+    }
+
+    GLuint VertexArray() const {
+        return m_VertexArray;
+    }
+
+private:
+    uint32_t m_VertexStride;
+    std::function<void()> m_SetupAttributes;
+    GLuint m_VertexArray = 0;
+    GLuint m_VertexBuffer = 0;
+    GLuint m_IndexBuffer = 0;
+    FreeListAllocator m_Vertices; // in vertices
+    FreeListAllocator m_Indices;  // in bytes
+    std::vector<GeometryRange> m_Ranges;
+    std::vector<uint32_t> m_FreeHandles;
+
+    // over a quarter of the space is free, but the largest hole holds less than half of that
+    static bool fragmented(const FreeListAllocator& allocator) {
+        return allocator.FreeUnits() > allocator.Capacity() / 4 && allocator.LargestFree() < allocator.FreeUnits() / 2;
+    }
+
+    static GLuint createBuffer(GLsizeiptr size) {
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return buffer;
+    }
+
+    static void copy(GLuint from, GLuint to, GLintptr fromOffset, GLintptr toOffset, GLsizeiptr size) {
+        if (size == 0) {
+            return;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, from);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, to);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, fromOffset, toOffset, size);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // grows the buffers to the given capacities, keeping their contents where they are
+    void resize(uint32_t vertexCapacity, uint32_t indexCapacity) {
+        GLuint vertexBuffer = createBuffer((GLsizeiptr) vertexCapacity * m_VertexStride);
+        GLuint indexBuffer = createBuffer(indexCapacity);
+        copy(m_VertexBuffer, vertexBuffer, 0, 0, (GLsizeiptr) m_Vertices.Capacity() * m_VertexStride);
+        copy(m_IndexBuffer, indexBuffer, 0, 0, m_Indices.Capacity());
+        replaceBuffers(vertexBuffer, indexBuffer);
+        m_Vertices.Grow(vertexCapacity);
+        m_Indices.Grow(indexCapacity);
+    }
+
+    // points the VAO at the new buffers and deletes the old ones
+    void replaceBuffers(GLuint vertexBuffer, GLuint indexBuffer) {
+        if (m_VertexBuffer != 0) {
+            glDeleteBuffers(1, &m_VertexBuffer);
+            glDeleteBuffers(1, &m_IndexBuffer);
+        }
+        m_VertexBuffer = vertexBuffer;
+        m_IndexBuffer = indexBuffer;
+        State().BindVertexArray(m_VertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
+        m_SetupAttributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBuffer);
+        State().BindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+};
+#endif //PROJECT_BASE_GEOMETRYPOOL_H
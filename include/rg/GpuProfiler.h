@@ -0,0 +1,208 @@
+#ifndef PROJECT_BASE_GPUPROFILER_H
+#define PROJECT_BASE_GPUPROFILER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+// GPU and CPU time of a fixed set of named passes. GPU time comes from GL_TIME_ELAPSED queries: every pass
+// has one query per frame in flight, and a result is only read once GL reports it available, so reading
+// never waits on the GPU. A result that still isn't there when its query comes round again is dropped.
+// CPU time is the wall time between Begin and End on the calling thread.
+//
+// Every pass can be timed once per frame. GL allows a single active GL_TIME_ELAPSED query, so passes can't
+// nest; time them one after the other, preferably with a Zone.
+class GpuProfiler {
+public:
+    // frames whose queries can be in flight at once; drivers commonly queue up to three
+    static const unsigned int FRAMES_IN_FLIGHT = 3;
+    // length of the rolling history kept for graphs
+    static const unsigned int HISTORY = 120;
+
+    struct Sample {
+        uint64_t frame;
+        double milliseconds;
+    };
+
+    // times a pass for as long as it lives
+    class Zone {
+    public:
+        Zone(GpuProfiler& profiler, unsigned int pass) : m_Profiler(profiler), m_Pass(pass) {
+            m_Profiler.Begin(m_Pass);
+        }
+        ~Zone() {
+            m_Profiler.End(m_Pass);
+        }
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+    private:
+        GpuProfiler& m_Profiler;
+        unsigned int m_Pass;
+    };
+
+    explicit GpuProfiler(std::vector<std::string> passes)
+        : m_Names(std::move(passes)), m_Slots(FRAMES_IN_FLIGHT * m_Names.size()), m_Passes(m_Names.size()) {
+        for (Slot& slot : m_Slots) {
+            glGenQueries(1, &slot.query);
+        }
+    }
+
+    ~GpuProfiler() {
+        for (Slot& slot : m_Slots) {
+            glDeleteQueries(1, &slot.query);
+        }
+    }
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // keeps every GPU result for Samples() (the benchmark report) instead of only the rolling history
+    void KeepSamples(bool keep) {
+        m_KeepSamples = keep;
+    }
+
+    // starts a frame, collecting whatever results of earlier frames have arrived; frame numbers have to count
+    // up by one
+    void BeginFrame(uint64_t frame) {
+        m_Frame = frame;
+        for (unsigned int i = 0; i < m_Slots.size(); ++i) {
+            collect(m_Slots[i], i % m_Names.size(), false);
+        }
+        // passes that aren't timed this frame show up as 0 in the graphs
+        for (Pass& pass : m_Passes) {
+            pass.gpuHistory[frame % HISTORY] = 0.0f;
+            pass.cpuHistory[frame % HISTORY] = 0.0f;
+        }
+    }
+
+    void Begin(unsigned int pass) {
+        if (m_Active >= 0) {
+            std::cout << "ERROR::PROFILER:: " << m_Names[pass] << " begins inside " << m_Names[m_Active] << std::endl;
+            return;
+        }
+        Slot& s = slot(m_Frame, pass);
+        if (s.issued) {
+            // still not available after FRAMES_IN_FLIGHT frames; the query is reused and its result lost
+            s.issued = false;
+            m_Dropped++;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, s.query);
+        s.frame = m_Frame;
+        m_Active = pass;
+        m_Passes[pass].cpuStart = std::chrono::steady_clock::now();
+    }
+
+    void End(unsigned int pass) {
+        if (m_Active != (int)pass) {
+            return;
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        slot(m_Frame, pass).issued = true;
+        m_Active = -1;
+
+        Pass& p = m_Passes[pass];
+        p.cpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - p.cpuStart).count();
+        p.cpuHistory[m_Frame % HISTORY] = (float)p.cpuMilliseconds;
+    }
+
+    // waits for every query still in flight; for the end of a run, not for use every frame
+    void Flush() {
+        for (unsigned int i = 0; i < m_Slots.size(); ++i) {
+            collect(m_Slots[i], i % m_Names.size(), true);
+        }
+    }
+
+    unsigned int PassCount() const {
+        return m_Names.size();
+    }
+    const std::string& Name(unsigned int pass) const {
+        return m_Names[pass];
+    }
+    // most recent results of the pass
+    double GpuMilliseconds(unsigned int pass) const {
+        return m_Passes[pass].gpuMilliseconds;
+    }
+    double CpuMilliseconds(unsigned int pass) const {
+        return m_Passes[pass].cpuMilliseconds;
+    }
+    // rolling histories, HISTORY entries indexed by frame % HISTORY; HistoryOffset() is the oldest entry
+    const float* GpuHistory(unsigned int pass) const {
+        return m_Passes[pass].gpuHistory;
+    }
+    const float* CpuHistory(unsigned int pass) const {
+        return m_Passes[pass].cpuHistory;
+    }
+    unsigned int HistoryOffset() const {
+        return (unsigned int)((m_Frame + 1) % HISTORY);
+    }
+    const std::vector<Sample>& Samples(unsigned int pass) const {
+        return m_Passes[pass].samples;
+    }
+    // results lost because they weren't available in time
+    uint64_t Dropped() const {
+        return m_Dropped;
+    }
+
+private:
+    struct Slot {
+        GLuint query = 0;
+        uint64_t frame = 0;
+        bool issued = false;
+    };
+
+    struct Pass {
+        double gpuMilliseconds = 0.0;
+        double cpuMilliseconds = 0.0;
+        float gpuHistory[HISTORY] = {};
+        float cpuHistory[HISTORY] = {};
+        std::chrono::steady_clock::time_point cpuStart;
+        std::vector<Sample> samples;
+    };
+
+    std::vector<std::string> m_Names;
+    std::vector<Slot> m_Slots; // FRAMES_IN_FLIGHT frames x passes
+    std::vector<Pass> m_Passes;
+    uint64_t m_Frame = 0;
+    uint64_t m_Dropped = 0;
+    int m_Active = -1;
+    bool m_KeepSamples = false;
+
+    Slot& slot(uint64_t frame, unsigned int pass) {
+        return m_Slots[(frame % FRAMES_IN_FLIGHT) * m_Names.size() + pass];
+    }
+
+    void collect(Slot& s, unsigned int pass, bool wait) {
+        if (!s.issued) {
+            return;
+        }
+        if (!wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(s.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                return;
+            }
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(s.query, GL_QUERY_RESULT, &nanoseconds);
+        s.issued = false;
+
+        Pass& p = m_Passes[pass];
+        double gpu = nanoseconds / 1.0e6;
+        p.gpuMilliseconds = gpu;
+        p.gpuHistory[s.frame % HISTORY] = (float)gpu;
+        if (m_KeepSamples) {
+            p.samples.push_back(Sample{s.frame, gpu});
+        }
+    }
+};
+
+};
+#endif //PROJECT_BASE_GPUPROFILER_H
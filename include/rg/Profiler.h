@@ -0,0 +1,213 @@
+#ifndef PROJECT_BASE_PROFILER_H
+#define PROJECT_BASE_PROFILER_H
+
+// CPU zone profiler. A zone is a named scope; its start and end times in nanoseconds are written to a ring
+// buffer owned by the calling thread, so recording takes no lock. RG_PROFILE_WRITE dumps the zones of every
+// thread as Chrome trace events, which chrome://tracing and ui.perfetto.dev show as one timeline per thread.
+//
+//     RG_PROFILE_THREAD("main");
+//     {
+//         RG_PROFILE_ZONE("load shaders");
+//         RG_PROFILE_ZONE_DETAIL("import model", path);
+//         ...
+//     }
+//     RG_PROFILE_WRITE("trace.json");
+//
+// Phases that can't be a scope of their own, because what they declare is used after them, are marked with
+// RG_PROFILE_BEGIN(id, name) and RG_PROFILE_END(id) in the same scope.
+//
+// Zone names have to be string literals; the detail is copied, keeping its last DETAIL_LENGTH - 1 characters.
+// Every thread keeps its last CAPACITY zones. Everything here compiles to nothing unless RG_PROFILE is defined
+// (cmake -DRG_PROFILE=ON).
+
+#ifdef RG_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+class Profiler {
+public:
+    // zones kept per thread; the oldest are overwritten first
+    static const size_t CAPACITY = 1 << 16;
+    static const size_t DETAIL_LENGTH = 40;
+
+    struct Event {
+        const char* name;
+        char detail[DETAIL_LENGTH];
+        uint64_t start;
+        uint64_t end;
+    };
+
+    // times the scope it lives in
+    class Zone {
+    public:
+        explicit Zone(const char* name, const char* detail = nullptr) : m_Name(name) {
+            m_Detail[0] = '\0';
+            if (detail != nullptr) {
+                // details are mostly paths, whose end says more than their start
+                size_t length = std::strlen(detail);
+                std::strncat(m_Detail, detail + (length >= DETAIL_LENGTH ? length - (DETAIL_LENGTH - 1) : 0), DETAIL_LENGTH - 1);
+            }
+            m_Start = Now();
+        }
+        Zone(const char* name, const std::string& detail) : Zone(name, detail.c_str()) {
+        }
+        ~Zone() {
+            End();
+        }
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+        // ends the zone before the end of its scope
+        void End() {
+            if (m_Name != nullptr) {
+                Instance().record(m_Name, m_Detail, m_Start, Now());
+                m_Name = nullptr;
+            }
+        }
+
+    private:
+        const char* m_Name;
+        char m_Detail[DETAIL_LENGTH];
+        uint64_t m_Start;
+    };
+
+    static Profiler& Instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    // nanoseconds since the profiler was first used
+    static uint64_t Now() {
+        static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void NameThread(const std::string& name) {
+        ThreadBuffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        buffer.name = name;
+    }
+
+    // Writes every recorded zone as Chrome trace JSON. Zones still being recorded by other threads while this
+    // runs may come out torn, so call it while the workers are idle, e.g. on exit.
+    bool Write(const std::string& path) {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            std::cout << "ERROR::PROFILER:: could not write " << path << std::endl;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+        bool first = true;
+        for (const std::shared_ptr<ThreadBuffer>& buffer : m_Threads) {
+            out << (first ? "" : ",\n") << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << buffer->id
+                << ", \"args\": {\"name\": \"" << escape(buffer->name) << "\"}}";
+            first = false;
+            size_t count = buffer->count.load(std::memory_order_acquire);
+            size_t begin = count > CAPACITY ? count - CAPACITY : 0;
+            for (size_t i = begin; i < count; ++i) {
+                const Event& event = buffer->events[i % CAPACITY];
+                // trace timestamps are in microseconds
+                out << ",\n{\"ph\": \"X\", \"name\": \"" << escape(event.name) << "\", \"pid\": 1, \"tid\": " << buffer->id
+                    << ", \"ts\": " << event.start / 1000 << '.' << pad(event.start % 1000)
+                    << ", \"dur\": " << (event.end - event.start) / 1000 << '.' << pad((event.end - event.start) % 1000);
+                if (event.detail[0] != '\0') {
+                    out << ", \"args\": {\"detail\": \"" << escape(event.detail) << "\"}";
+                }
+                out << "}";
+            }
+        }
+        out << "\n]}\n";
+        return (bool)out;
+    }
+
+private:
+    struct ThreadBuffer {
+        unsigned int id = 0;
+        std::string name;
+        std::vector<Event> events;
+        // zones recorded so far; events[count % CAPACITY] is the next one written
+        std::atomic<size_t> count{0};
+    };
+
+    std::mutex m_Mutex;
+    // owned here rather than by the threads, so the zones of a thread that has exited can still be written
+    std::vector<std::shared_ptr<ThreadBuffer>> m_Threads;
+
+    Profiler() = default;
+
+    ThreadBuffer& threadBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (buffer == nullptr) {
+            std::shared_ptr<ThreadBuffer> created = std::make_shared<ThreadBuffer>();
+            created->events.resize(CAPACITY);
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            created->id = m_Threads.size() + 1;
+            created->name = "thread " + std::to_string(created->id);
+            m_Threads.push_back(created);
+            buffer = created.get();
+        }
+        return *buffer;
+    }
+
+    void record(const char* name, const char* detail, uint64_t start, uint64_t end) {
+        ThreadBuffer& buffer = threadBuffer();
+        size_t count = buffer.count.load(std::memory_order_relaxed);
+        Event& event = buffer.events[count % CAPACITY];
+        event.name = name;
+        std::memcpy(event.detail, detail, DETAIL_LENGTH);
+        event.start = start;
+        event.end = end;
+        buffer.count.store(count + 1, std::memory_order_release);
+    }
+
+    static std::string pad(uint64_t nanoseconds) {
+        std::string digits = std::to_string(nanoseconds);
+        return std::string(3 - digits.size(), '0') + digits;
+    }
+
+    static std::string escape(const std::string& value) {
+        std::string escaped;
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += (unsigned char)c < 0x20 ? ' ' : c;
+        }
+        return escaped;
+    }
+};
+
+};
+
+#define RG_PROFILE_CONCAT_(a, b) a##b
+#define RG_PROFILE_CONCAT(a, b) RG_PROFILE_CONCAT_(a, b)
+#define RG_PROFILE_ZONE(name) rg::Profiler::Zone RG_PROFILE_CONCAT(rgProfileZone, __LINE__)(name)
+#define RG_PROFILE_ZONE_DETAIL(name, detail) rg::Profiler::Zone RG_PROFILE_CONCAT(rgProfileZone, __LINE__)(name, detail)
+#define RG_PROFILE_BEGIN(id, name) rg::Profiler::Zone rgProfileZone_##id(name)
+#define RG_PROFILE_END(id) rgProfileZone_##id.End()
+#define RG_PROFILE_THREAD(name) rg::Profiler::Instance().NameThread(name)
+#define RG_PROFILE_WRITE(path) rg::Profiler::Instance().Write(path)
+
+#else
+
+#define RG_PROFILE_ZONE(name)
+#define RG_PROFILE_ZONE_DETAIL(name, detail)
+#define RG_PROFILE_BEGIN(id, name)
+#define RG_PROFILE_END(id)
+#define RG_PROFILE_THREAD(name)
+#define RG_PROFILE_WRITE(path)
+
+#endif
+#endif //PROJECT_BASE_PROFILER_H
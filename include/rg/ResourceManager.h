@@ -0,0 +1,305 @@
+#ifndef PROJECT_BASE_RESOURCEMANAGER_H
+#define PROJECT_BASE_RESOURCEMANAGER_H
+
+#include <glad/glad.h>
+#include <rg/GeometryPool.h>
+#include <rg/GLState.h>
+
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+// Reference to a registry entry. The generation is bumped every time a slot is freed, so a handle that
+// outlived its resource is detected instead of silently pointing at whatever reused the slot.
+template<typename Tag>
+struct Handle {
+    uint32_t index = 0;
+    uint32_t generation = 0; // 0 is never a live generation
+
+    bool Valid() const {
+        return generation != 0;
+    }
+    bool operator==(const Handle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+};
+
+struct TextureTag;
+struct MeshTag;
+struct ProgramTag;
+using TextureHandle = Handle<TextureTag>;
+using MeshHandle = Handle<MeshTag>;
+using ProgramHandle = Handle<ProgramTag>;
+
+// GL objects owned by the registry; bytes is an estimate of the video memory they take
+struct TextureResource {
+    unsigned int id = 0;
+    GLenum target = GL_TEXTURE_2D;
+    size_t bytes = 0;
+};
+
+// vertex and index ranges of one mesh in a geometry pool, drawn from the pool's VAO by every user
+struct MeshResource {
+    GeometryPool* pool = nullptr;
+    uint32_t allocation = 0;
+    unsigned int indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t bytes = 0;
+};
+
+struct ProgramResource {
+    unsigned int id = 0;
+};
+
+// Reference counted resources of one kind, deduplicated by key. Lookup and acquisition are thread safe so
+// loader workers can claim resources; creating and destroying the GL objects is up to the GL thread.
+template<typename Resource, typename Tag>
+class ResourcePool {
+public:
+    using HandleType = Handle<Tag>;
+
+    explicit ResourcePool(std::function<void(const Resource&)> destroy) : m_Destroy(std::move(destroy)) {
+    }
+
+    // returns the entry for key with one more reference. If the key wasn't registered yet a new, empty entry is
+    // made and created is set: the caller then has to load the resource and Set() it.
+    HandleType Acquire(const std::string& key, bool& created) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto found = m_Lookup.find(key);
+        if (found != m_Lookup.end()) {
+            Slot& slot = m_Slots[found->second];
+            slot.refCount++;
+            created = false;
+            return HandleType{found->second, slot.generation};
+        }
+
+        uint32_t index;
+        if (!m_Free.empty()) {
+            index = m_Free.back();
+            m_Free.pop_back();
+        } else {
+            index = m_Slots.size();
+            m_Slots.emplace_back();
+        }
+        Slot& slot = m_Slots[index];
+        slot.key = key;
+        slot.refCount = 1;
+        slot.resident = false;
+        slot.resource = Resource();
+        m_Lookup.emplace(key, index);
+        created = true;
+        return HandleType{index, slot.generation};
+    }
+
+    // entry for key without taking a reference; invalid if there is none
+    HandleType Find(const std::string& key) const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto found = m_Lookup.find(key);
+        if (found == m_Lookup.end()) {
+            return HandleType();
+        }
+        return HandleType{found->second, m_Slots[found->second].generation};
+    }
+
+    // stores the loaded resource of a created entry
+    void Set(HandleType handle, const Resource& resource) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (Slot* slot = find(handle)) {
+            slot->resource = resource;
+            slot->resident = true;
+        }
+    }
+
+    // the resource, or a default constructed one if the handle is stale or the resource isn't loaded yet
+    Resource Get(HandleType handle) const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        const Slot* slot = find(handle);
+        return slot != nullptr ? slot->resource : Resource();
+    }
+
+    bool IsResident(HandleType handle) const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        const Slot* slot = find(handle);
+        return slot != nullptr && slot->resident;
+    }
+
+    void AddRef(HandleType handle) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (Slot* slot = find(handle)) {
+            slot->refCount++;
+        }
+    }
+
+    // drops one reference and destroys the resource with the last one; GL thread only
+    void Release(HandleType handle) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        Slot* slot = find(handle);
+        if (slot != nullptr && --slot->refCount == 0) {
+            destroy(handle.index);
+        }
+    }
+
+    // Destroys the resource now and makes every outstanding handle stale, but only if the caller holds the last
+    // reference. Meshes keep the raw GL names and pool allocations resolved at load time, and a name or
+    // allocation freed under them is handed to the next load, so they would silently draw someone else's data;
+    // with other references the unload is refused and false returned. GL thread only.
+    bool Unload(HandleType handle) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        Slot* slot = find(handle);
+        if (slot == nullptr) {
+            return false;
+        }
+        if (slot->refCount > 1) {
+            std::cout << "ERROR::RESOURCES:: not unloading " << slot->key << ", " << slot->refCount - 1
+                      << " other references still use it" << std::endl;
+            return false;
+        }
+        destroy(handle.index);
+        return true;
+    }
+
+    // calls f(key, resource, refCount) for every registered entry
+    template<typename F>
+    void ForEach(F f) const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (const Slot& slot : m_Slots) {
+            if (slot.refCount > 0) {
+                f(slot.key, slot.resource, slot.refCount);
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        Resource resource;
+        std::string key;
+        uint32_t generation = 1;
+        uint32_t refCount = 0;
+        bool resident = false;
+    };
+
+    std::vector<Slot> m_Slots;
+    std::vector<uint32_t> m_Free;
+    std::unordered_map<std::string, uint32_t> m_Lookup;
+    std::function<void(const Resource&)> m_Destroy;
+    mutable std::mutex m_Mutex;
+
+    Slot* find(HandleType handle) {
+        if (handle.index >= m_Slots.size() || m_Slots[handle.index].generation != handle.generation
+            || m_Slots[handle.index].refCount == 0) {
+            return nullptr;
+        }
+        return &m_Slots[handle.index];
+    }
+    const Slot* find(HandleType handle) const {
+        return const_cast<ResourcePool*>(this)->find(handle);
+    }
+
+    void destroy(uint32_t index) {
+        Slot& slot = m_Slots[index];
+        if (slot.resident) {
+            m_Destroy(slot.resource);
+        }
+        m_Lookup.erase(slot.key);
+        slot.key.clear();
+        slot.refCount = 0;
+        slot.resident = false;
+        // skip 0 on wrap-around, it marks invalid handles
+        slot.generation = slot.generation == UINT32_MAX ? 1 : slot.generation + 1;
+        m_Free.push_back(index);
+    }
+};
+
+// Process-wide registry of the GPU resources shared between models: textures, mesh buffers and shader
+// programs. Entries are keyed by canonical file path plus the parameters they were loaded with, so the same
+// image loaded by two models is uploaded once.
+class ResourceManager {
+public:
+    ResourceManager()
+        // a deleted name can be handed out again, so the state cache mustn't remember it as bound
+        : m_Textures([](const TextureResource& texture) {
+              glDeleteTextures(1, &texture.id);
+              State().Invalidate();
+          }),
+          m_Meshes([](const MeshResource& mesh) {
+              mesh.pool->Free(mesh.allocation);
+          }),
+          m_Programs([](const ProgramResource& program) {
+              glDeleteProgram(program.id);
+              State().Invalidate();
+              State().InvalidateSamplers();
+          }) {
+    }
+
+    ResourcePool<TextureResource, TextureTag>& Textures() {
+        return m_Textures;
+    }
+    ResourcePool<MeshResource, MeshTag>& Meshes() {
+        return m_Meshes;
+    }
+    ResourcePool<ProgramResource, ProgramTag>& Programs() {
+        return m_Programs;
+    }
+
+    // registry key of a file loaded with the given parameters; the path is made canonical so different
+    // spellings of the same file share an entry
+    static std::string Key(const std::string& path, const std::string& parameters = "") {
+        std::string key = path;
+        if (char* resolved = realpath(path.c_str(), nullptr)) {
+            key = resolved;
+            free(resolved);
+        }
+        if (!parameters.empty()) {
+            key += '|';
+            key += parameters;
+        }
+        return key;
+    }
+
+    // prints every registered resource with its reference count and estimated size
+    void Report(std::ostream& out) {
+        size_t textureBytes = 0, meshBytes = 0;
+        unsigned int textureCount = 0, meshCount = 0, programCount = 0;
+        out << "Resident resources:\n";
+        m_Textures.ForEach([&](const std::string& key, const TextureResource& texture, uint32_t refCount) {
+            out << "  texture " << std::setw(8) << texture.bytes / 1024 << " KB  refs " << refCount << "  " << key << '\n';
+            textureBytes += texture.bytes;
+            textureCount++;
+        });
+        m_Meshes.ForEach([&](const std::string& key, const MeshResource& mesh, uint32_t refCount) {
+            out << "  mesh    " << std::setw(8) << mesh.bytes / 1024 << " KB  refs " << refCount << "  " << key << '\n';
+            meshBytes += mesh.bytes;
+            meshCount++;
+        });
+        m_Programs.ForEach([&](const std::string& key, const ProgramResource&, uint32_t refCount) {
+            out << "  program              refs " << refCount << "  " << key << '\n';
+            programCount++;
+        });
+        out << "  " << textureCount << " textures (" << textureBytes / (1024 * 1024) << " MB), "
+            << meshCount << " meshes (" << meshBytes / (1024 * 1024) << " MB), "
+            << programCount << " programs" << std::endl;
+    }
+
+private:
+    ResourcePool<TextureResource, TextureTag> m_Textures;
+    ResourcePool<MeshResource, MeshTag> m_Meshes;
+    ResourcePool<ProgramResource, ProgramTag> m_Programs;
+};
+
+ResourceManager& Resources() {
+    static ResourceManager manager;
+    return manager;
+}
+
+};
+#endif //PROJECT_BASE_RESOURCEMANAGER_H
@@ -0,0 +1,98 @@
+#ifndef PROJECT_BASE_THREADPOOL_H
+#define PROJECT_BASE_THREADPOOL_H
+
+#include <rg/Profiler.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rg {
+
+// Fixed set of worker threads running queued tasks in FIFO order.
+// Tasks must not touch OpenGL: the context is only current on the main thread.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency()) {
+        if (threadCount == 0) {
+            threadCount = 1;
+        }
+        for (unsigned int i = 0; i < threadCount; ++i) {
+            m_Workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // finishes the tasks that are already queued and joins the workers
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stopping = true;
+        }
+        m_Signal.notify_all();
+        for (std::thread& worker : m_Workers) {
+            worker.join();
+        }
+    }
+
+    void Submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Tasks.push_back(std::move(task));
+        }
+        m_Signal.notify_one();
+    }
+
+    // runs one queued task on the calling thread, so a thread waiting on the pool can help instead of idling;
+    // returns false if the queue was empty
+    bool RunPending() {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Tasks.empty()) {
+                return false;
+            }
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop_front();
+        }
+        task();
+        return true;
+    }
+
+    unsigned int Size() const {
+        return m_Workers.size();
+    }
+
+private:
+    std::vector<std::thread> m_Workers;
+    std::deque<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Signal;
+    bool m_Stopping = false;
+
+    void workerLoop(unsigned int index) {
+        RG_PROFILE_THREAD("worker " + std::to_string(index));
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Signal.wait(lock, [this] { return m_Stopping || !m_Tasks.empty(); });
+                if (m_Tasks.empty()) {
+                    return;
+                }
+                task = std::move(m_Tasks.front());
+                m_Tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+};
+#endif //PROJECT_BASE_THREADPOOL_H
@@ -0,0 +1,136 @@
+#ifndef PROJECT_BASE_UNIFORM_H
+#define PROJECT_BASE_UNIFORM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+// Location of a uniform of type T, resolved once through the shader's uniform table so that setting it needs
+// neither a string nor a driver lookup. An invalid handle (location -1) is ignored by GL, like a name that
+// isn't an active uniform.
+template<typename T>
+struct Uniform {
+    GLint location = -1;
+
+    bool Valid() const {
+        return location >= 0;
+    }
+};
+
+struct UniformInfo {
+    GLint location;
+    GLenum type;
+    GLint size; // number of elements for arrays, 1 otherwise
+};
+
+// GL type a C++ uniform type has to match; samplers are set as int
+template<typename T> struct UniformGLType;
+template<> struct UniformGLType<bool>      { static bool Matches(GLenum type) { return type == GL_BOOL; } };
+template<> struct UniformGLType<float>     { static bool Matches(GLenum type) { return type == GL_FLOAT; } };
+template<> struct UniformGLType<glm::vec2> { static bool Matches(GLenum type) { return type == GL_FLOAT_VEC2; } };
+template<> struct UniformGLType<glm::vec3> { static bool Matches(GLenum type) { return type == GL_FLOAT_VEC3; } };
+template<> struct UniformGLType<glm::vec4> { static bool Matches(GLenum type) { return type == GL_FLOAT_VEC4; } };
+template<> struct UniformGLType<glm::mat2> { static bool Matches(GLenum type) { return type == GL_FLOAT_MAT2; } };
+template<> struct UniformGLType<glm::mat3> { static bool Matches(GLenum type) { return type == GL_FLOAT_MAT3; } };
+template<> struct UniformGLType<glm::mat4> { static bool Matches(GLenum type) { return type == GL_FLOAT_MAT4; } };
+template<> struct UniformGLType<int> {
+    static bool Matches(GLenum type) {
+        switch (type) {
+            case GL_INT: case GL_BOOL:
+            case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE: case GL_SAMPLER_2D_SHADOW:
+            case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_BUFFER: case GL_INT_SAMPLER_BUFFER:
+            case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+                return true;
+        }
+        return false;
+    }
+};
+
+inline void SetUniform(GLint location, bool value)             { glUniform1i(location, (int)value); }
+inline void SetUniform(GLint location, int value)              { glUniform1i(location, value); }
+inline void SetUniform(GLint location, float value)            { glUniform1f(location, value); }
+inline void SetUniform(GLint location, const glm::vec2& value) { glUniform2fv(location, 1, &value[0]); }
+inline void SetUniform(GLint location, const glm::vec3& value) { glUniform3fv(location, 1, &value[0]); }
+inline void SetUniform(GLint location, const glm::vec4& value) { glUniform4fv(location, 1, &value[0]); }
+inline void SetUniform(GLint location, const glm::mat2& value) { glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void SetUniform(GLint location, const glm::mat3& value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void SetUniform(GLint location, const glm::mat4& value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+
+// Active uniforms of a linked program, enumerated once after linking. Arrays are registered under their
+// base name ("lightPos"), the name GL reports ("lightPos[0]") and every element ("lightPos[3]"), so any
+// spelling the shader code uses resolves without asking the driver.
+class UniformTable {
+public:
+    void Reflect(GLuint program) {
+        m_Uniforms.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength + 1);
+        for (GLint i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint location = glGetUniformLocation(program, name.c_str());
+            if (location < 0) {
+                continue; // uniform block member
+            }
+            m_Uniforms[name] = UniformInfo{location, type, size};
+
+            // "name[0]" of an array: also register the base name and the other elements
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+                std::string base = name.substr(0, name.size() - 3);
+                m_Uniforms[base] = UniformInfo{location, type, size};
+                for (GLint element = 1; element < size; ++element) {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    m_Uniforms[elementName] = UniformInfo{glGetUniformLocation(program, elementName.c_str()), type, 1};
+                }
+            }
+        }
+    }
+
+    // -1 if the program has no active uniform of that name
+    GLint Location(const std::string& name) const {
+        auto found = m_Uniforms.find(name);
+        return found != m_Uniforms.end() ? found->second.location : -1;
+    }
+
+    const UniformInfo* Find(const std::string& name) const {
+        auto found = m_Uniforms.find(name);
+        return found != m_Uniforms.end() ? &found->second : nullptr;
+    }
+
+    // typed handle of a uniform; reports a type mismatch instead of letting GL fail the set call later
+    template<typename T>
+    Uniform<T> Resolve(const std::string& name) const {
+        Uniform<T> uniform;
+        const UniformInfo* info = Find(name);
+        if (info == nullptr) {
+            return uniform;
+        }
+        if (!UniformGLType<T>::Matches(info->type)) {
+            std::cout << "ERROR::SHADER::UNIFORM:: type of " << name << " doesn't match the handle type" << std::endl;
+            return uniform;
+        }
+        uniform.location = info->location;
+        return uniform;
+    }
+
+    size_t Size() const {
+        return m_Uniforms.size();
+    }
+
+private:
+    std::unordered_map<std::string, UniformInfo> m_Uniforms;
+};
+
+};
+#endif //PROJECT_BASE_UNIFORM_H
@@ -0,0 +1,147 @@
+#ifndef PROJECT_BASE_UNIFORMBUFFER_H
+#define PROJECT_BASE_UNIFORMBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace rg {
+
+// Fixed binding points of the uniform blocks declared in resources/shaders/uniform_blocks.glsl. GLSL 330
+// can't say layout(binding = N), so every program is pointed at them after linking by BindUniformBlocks().
+const GLuint CAMERA_BLOCK_BINDING = 0;
+const GLuint LIGHTS_BLOCK_BINDING = 1;
+const GLuint CLUSTERS_BLOCK_BINDING = 2;
+
+// froxel grid of the clustered point light lists, see learnopengl/clustered.h; the GLSL defines have to match
+const unsigned int CLUSTERS_X = 16;
+const unsigned int CLUSTERS_Y = 9;
+const unsigned int CLUSTERS_Z = 24;
+
+// std140 mirrors of the GLSL blocks; a vec3 followed by a float fills exactly one 16 byte slot
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    float padding;
+};
+
+struct DirLightBlock {
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+
+// point lights don't live in a uniform block, but the per-light buffers use the same layout, with the padding
+// holding the light's radius
+struct PointLightBlock {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float padding;
+};
+
+struct SpotLightBlock {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 direction;
+    float linear;
+    glm::vec3 ambient;
+    float quadratic;
+    glm::vec3 diffuse;
+    float cutOff;
+    glm::vec3 specular;
+    float outerCutOff;
+};
+
+struct LightsBlock {
+    DirLightBlock dirLight;
+    SpotLightBlock spotLight;
+};
+
+// maps a fragment to its cluster: tile = gl_FragCoord.xy * tileScale, slice = log(view depth) * sliceScale + sliceBias
+struct ClustersBlock {
+    glm::vec2 tileScale;
+    float sliceScale;
+    float sliceBias;
+};
+
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock doesn't match the std140 layout of Camera");
+static_assert(sizeof(DirLightBlock) == 64 && sizeof(PointLightBlock) == 64 && sizeof(SpotLightBlock) == 80,
+              "light structs don't match their std140 layout");
+static_assert(sizeof(LightsBlock) == 64 + 80, "LightsBlock doesn't match the std140 layout of Lights");
+static_assert(sizeof(ClustersBlock) == 16, "ClustersBlock doesn't match the std140 layout of Clusters");
+
+// Distance at which the light's strongest channel falls to 5/256 of full strength, which doesn't show after
+// tone mapping; lights without distance falloff reach the far plane of the scene.
+float PointLightRadius(const PointLightBlock& light) {
+    glm::vec3 color = light.ambient + light.diffuse + light.specular;
+    float strength = std::max(color.x, std::max(color.y, color.z)) * 256.0f / 5.0f;
+    if (strength <= light.constant) {
+        return 0.0f;
+    }
+    if (light.quadratic > 0.0f) {
+        return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * (light.constant - strength)))
+               / (2.0f * light.quadratic);
+    }
+    if (light.linear > 0.0f) {
+        return (strength - light.constant) / light.linear;
+    }
+    return 100.0f;
+}
+
+// points the program's Camera, Lights and Clusters blocks, if it uses them, at their binding points
+void BindUniformBlocks(GLuint program) {
+    GLuint camera = glGetUniformBlockIndex(program, "Camera");
+    if (camera != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, camera, CAMERA_BLOCK_BINDING);
+    }
+    GLuint lights = glGetUniformBlockIndex(program, "Lights");
+    if (lights != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, lights, LIGHTS_BLOCK_BINDING);
+    }
+    GLuint clusters = glGetUniformBlockIndex(program, "Clusters");
+    if (clusters != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, clusters, CLUSTERS_BLOCK_BINDING);
+    }
+}
+
+// Uniform buffer holding one Block, attached to a fixed binding point for its whole lifetime.
+template<typename Block>
+class UniformBuffer {
+public:
+    explicit UniformBuffer(GLuint binding) {
+        glGenBuffers(1, &m_Id);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_Id);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_Id);
+    }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    // replaces the contents; the old storage is orphaned so the upload doesn't wait for draws still reading it
+    void Upload(const Block& block) {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_Id);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+    GLuint m_Id = 0;
+};
+
+};
+#endif //PROJECT_BASE_UNIFORMBUFFER_H
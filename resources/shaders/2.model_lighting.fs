@@ -1,25 +1,8 @@
 #version 330 core
 out vec4 FragColor;
 
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+#include "uniform_blocks.glsl"
+#include "clustered_lights.glsl"
 
 struct Material {
     sampler2D diffuse;
@@ -28,17 +11,12 @@ struct Material {
     float shininess;
 };
 
-#define NR_POINT_LIGHTS 4
-
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform DirLight dirLight;
 uniform Material material;
 uniform bool blinnPhong;
-uniform vec3 viewPos;
 
 // function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
@@ -58,9 +36,10 @@ void main()
         // == =====================================================
         // phase 1: directional lighting
         vec3 result = CalcDirLight(dirLight, norm, viewDir);
-        // phase 2: point lights
-        for(int i = 0; i < NR_POINT_LIGHTS; i++)
-            result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+        // phase 2: point lights, only those reaching this fragment's cluster
+        uvec2 lights = ClusterLights();
+        for(uint i = 0u; i < lights.y; i++)
+            result += CalcPointLight(ClusterLight(lights.x + i), norm, FragPos, viewDir);
         // phase 3: spot light
         // no spotlights
 
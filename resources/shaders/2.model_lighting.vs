@@ -1,20 +1,25 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoords;
+#include "packed_vertex.glsl"
+// per-instance model matrix, used instead of the model uniform when instanced is set
+layout (location = 5) in mat4 aInstanceModel;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+// the depth pre-pass and the passes shading with GL_EQUAL run different programs on this shader, so the
+// position has to come out bit for bit the same in all of them
+invariant gl_Position;
+
+#include "uniform_blocks.glsl"
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform bool instanced;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    mat4 worldModel = instanced ? aInstanceModel : model;
+    FragPos = vec3(worldModel * vec4(VertexPosition(), 1.0));
+    Normal = mat3(transpose(inverse(worldModel))) * VertexNormal();
     TexCoords = aTexCoords;    
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
@@ -2,6 +2,10 @@
 out vec4 FragColor;
 
 in vec2 TexCoords;
+in vec3 FragPos;
+
+#include "uniform_blocks.glsl"
+#include "clustered_lights.glsl"
 
 uniform sampler2D texture1;
 
@@ -10,5 +14,15 @@ void main()
     vec4 texColor = texture(texture1, TexCoords);
     if(texColor.a < 0.1)
         discard;
-    FragColor = texColor;
-}
\ No newline at end of file
+    // the leaves are drawn unlit; the lamps of this fragment's cluster add to that, whichever side they are on
+    vec3 result = texColor.rgb;
+    uvec2 lights = ClusterLights();
+    for(uint i = 0u; i < lights.y; i++)
+    {
+        PointLight light = ClusterLight(lights.x + i);
+        float distance = length(light.position - FragPos);
+        float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+        result += (light.ambient + light.diffuse) * texColor.rgb * attenuation;
+    }
+    FragColor = vec4(result, texColor.a);
+}
@@ -0,0 +1,60 @@
+#version 330 core
+layout (location = 0) out vec3 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture;
+uniform vec2 srcTexelSize;
+// the first pass reads the full resolution bright buffer; weighting its boxes by luminance keeps single
+// very bright pixels from flickering through the whole chain
+uniform bool firstPass;
+
+float karisWeight(vec3 c)
+{
+    float luma = dot(c, vec3(0.2126, 0.7152, 0.0722));
+    return 1.0 / (1.0 + luma);
+}
+
+// 13 bilinear taps arranged as five overlapping 2x2 boxes, as in Jimenez, "Next Generation Post Processing
+// in Call of Duty: Advanced Warfare":
+//   a - b - c
+//   - j - k -
+//   d - e - f
+//   - l - m -
+//   g - h - i
+void main()
+{
+    vec2 t = srcTexelSize;
+    vec3 a = texture(srcTexture, TexCoords + vec2(-2.0 * t.x,  2.0 * t.y)).rgb;
+    vec3 b = texture(srcTexture, TexCoords + vec2( 0.0,        2.0 * t.y)).rgb;
+    vec3 c = texture(srcTexture, TexCoords + vec2( 2.0 * t.x,  2.0 * t.y)).rgb;
+    vec3 d = texture(srcTexture, TexCoords + vec2(-2.0 * t.x,  0.0)).rgb;
+    vec3 e = texture(srcTexture, TexCoords).rgb;
+    vec3 f = texture(srcTexture, TexCoords + vec2( 2.0 * t.x,  0.0)).rgb;
+    vec3 g = texture(srcTexture, TexCoords + vec2(-2.0 * t.x, -2.0 * t.y)).rgb;
+    vec3 h = texture(srcTexture, TexCoords + vec2( 0.0,       -2.0 * t.y)).rgb;
+    vec3 i = texture(srcTexture, TexCoords + vec2( 2.0 * t.x, -2.0 * t.y)).rgb;
+    vec3 j = texture(srcTexture, TexCoords + vec2(-t.x,  t.y)).rgb;
+    vec3 k = texture(srcTexture, TexCoords + vec2( t.x,  t.y)).rgb;
+    vec3 l = texture(srcTexture, TexCoords + vec2(-t.x, -t.y)).rgb;
+    vec3 m = texture(srcTexture, TexCoords + vec2( t.x, -t.y)).rgb;
+
+    // the inner box counts for half, the four corner boxes for an eighth each
+    vec3 boxes[5] = vec3[](
+        (j + k + l + m) * 0.25,
+        (a + b + d + e) * 0.25,
+        (b + c + e + f) * 0.25,
+        (d + e + g + h) * 0.25,
+        (e + f + h + i) * 0.25);
+    float weights[5] = float[](0.5, 0.125, 0.125, 0.125, 0.125);
+
+    vec3 result = vec3(0.0);
+    float total = 0.0;
+    for (int n = 0; n < 5; ++n)
+    {
+        float w = firstPass ? weights[n] * karisWeight(boxes[n]) : weights[n];
+        result += boxes[n] * w;
+        total += w;
+    }
+    FragColor = max(result / total, vec3(0.0001));
+}
@@ -0,0 +1,26 @@
+#version 330 core
+layout (location = 0) out vec3 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture;
+uniform vec2 srcTexelSize;
+// tent radius in texels of the smaller level
+uniform float filterRadius;
+
+// 3x3 tent filter; the result is blended additively into the larger level
+void main()
+{
+    vec2 r = srcTexelSize * filterRadius;
+    vec3 a = texture(srcTexture, TexCoords + vec2(-r.x,  r.y)).rgb;
+    vec3 b = texture(srcTexture, TexCoords + vec2( 0.0,  r.y)).rgb;
+    vec3 c = texture(srcTexture, TexCoords + vec2( r.x,  r.y)).rgb;
+    vec3 d = texture(srcTexture, TexCoords + vec2(-r.x,  0.0)).rgb;
+    vec3 e = texture(srcTexture, TexCoords).rgb;
+    vec3 f = texture(srcTexture, TexCoords + vec2( r.x,  0.0)).rgb;
+    vec3 g = texture(srcTexture, TexCoords + vec2(-r.x, -r.y)).rgb;
+    vec3 h = texture(srcTexture, TexCoords + vec2( 0.0, -r.y)).rgb;
+    vec3 i = texture(srcTexture, TexCoords + vec2( r.x, -r.y)).rgb;
+
+    FragColor = (e * 4.0 + (b + d + f + h) * 2.0 + (a + c + g + i)) / 16.0;
+}
@@ -0,0 +1,30 @@
+// Point lights of the fragment's cluster, built by ClusteredLights (include/learnopengl/clustered.h); needs
+// uniform_blocks.glsl included first.
+//     uvec2 lights = ClusterLights();
+//     for (uint i = 0u; i < lights.y; i++)
+//         result += CalcPointLight(ClusterLight(lights.x + i), ...);
+
+uniform usamplerBuffer clusterGrid;         // offset and length of the light list of every cluster
+uniform usamplerBuffer clusterLightIndices; // the lists
+uniform samplerBuffer clusterLights;        // four texels per light, padding holds the radius
+
+// offset and length of the light list of the cluster this fragment falls into
+uvec2 ClusterLights()
+{
+    // view depth, undoing the perspective projection of the window depth
+    float depth = projection[3][2] / (gl_FragCoord.z * 2.0 - 1.0 + projection[2][2]);
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * clusterTileScale), int(floor(log(depth) * clusterSliceScale + clusterSliceBias)));
+    cluster = clamp(cluster, ivec3(0), ivec3(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z) - 1);
+    return texelFetch(clusterGrid, (cluster.z * CLUSTERS_Y + cluster.y) * CLUSTERS_X + cluster.x).xy;
+}
+
+PointLight ClusterLight(uint i)
+{
+    int texel = int(texelFetch(clusterLightIndices, int(i)).r) * 4;
+    vec4 positionConstant = texelFetch(clusterLights, texel);
+    vec4 ambientLinear = texelFetch(clusterLights, texel + 1);
+    vec4 diffuseQuadratic = texelFetch(clusterLights, texel + 2);
+    vec4 specularRadius = texelFetch(clusterLights, texel + 3);
+    return PointLight(positionConstant.xyz, positionConstant.w, ambientLinear.xyz, ambientLinear.w,
+                      diffuseQuadratic.xyz, diffuseQuadratic.w, specularRadius.xyz, specularRadius.w);
+}
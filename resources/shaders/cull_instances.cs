@@ -0,0 +1,116 @@
+#version 430 core
+// Culls one field of instances (include/learnopengl/gpu_culling.h): every invocation tests one instance against
+// the frustum and, when occlusion is set, against the Hi-Z pyramid of the last frame. A survivor takes the next
+// slot of its field and writes one InstanceRecord per mesh there, and bumps the instance count of every mesh's
+// draw command, so the commands draw exactly the survivors without the CPU ever seeing them.
+layout (local_size_x = 64) in;
+
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    uint baseVertex;
+    uint baseInstance;
+};
+
+struct InstanceRecord
+{
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsExtent;
+};
+
+// a mesh of the field's model: its packing bounds and its draw command
+struct CulledMesh
+{
+    vec4 boundsMin;
+    vec4 boundsExtent;
+    uint command;
+    uint pad0, pad1, pad2;
+};
+
+layout (std430, binding = 0) readonly buffer Transforms { mat4 transforms[]; };
+layout (std430, binding = 1) buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 2) writeonly buffer Records { InstanceRecord records[]; };
+layout (std430, binding = 3) readonly buffer Meshes { CulledMesh meshes[]; };
+
+uniform int firstTransform;
+uniform int instanceCount;
+uniform int firstMesh;
+uniform int meshCount;
+// bounding sphere of the model, in model space
+uniform vec4 sphere;
+// the frustum planes (rg::Frustum), normalized and facing inwards
+uniform vec4 planes[6];
+
+uniform bool occlusion;
+// farthest depth of every 2x2 block of the level above; level 0 is half the depth buffer's size
+uniform sampler2D hiZ;
+uniform int hiZLevels;
+uniform vec2 depthSize;
+// the view-projection the pyramid's depth was drawn with
+uniform mat4 hiZViewProjection;
+
+bool occluded(vec3 center, float radius)
+{
+    // screen rectangle and nearest depth of the box around the sphere, as seen last frame
+    vec3 lo = vec3(1.0);
+    vec3 hi = vec3(-1.0);
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = hiZViewProjection * vec4(corner, 1.0);
+        // reaches behind the camera: the rectangle is unbounded
+        if (clip.w <= 0.0)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        lo = min(lo, ndc);
+        hi = max(hi, ndc);
+    }
+    vec2 pixelMin = clamp(lo.xy * 0.5 + 0.5, 0.0, 1.0) * depthSize;
+    vec2 pixelMax = clamp(hi.xy * 0.5 + 0.5, 0.0, 1.0) * depthSize;
+    float nearest = lo.z * 0.5 + 0.5;
+
+    // the level whose texels (2^(level+1) pixels wide) the rectangle spans at most two of in each direction
+    vec2 extent = pixelMax - pixelMin;
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))) - 1, 0, hiZLevels - 1);
+    ivec2 levelSize = textureSize(hiZ, level);
+    // the last texel of a level also covers the odd pixels left over by the reduction
+    ivec2 a = min(ivec2(pixelMin) >> (level + 1), levelSize - 1);
+    ivec2 b = min(ivec2(pixelMax) >> (level + 1), levelSize - 1);
+    float farthest = max(max(texelFetch(hiZ, a, level).r, texelFetch(hiZ, ivec2(b.x, a.y), level).r),
+                         max(texelFetch(hiZ, ivec2(a.x, b.y), level).r, texelFetch(hiZ, b, level).r));
+    return nearest > farthest;
+}
+
+void main()
+{
+    int instance = int(gl_GlobalInvocationID.x);
+    if (instance >= instanceCount)
+        return;
+    mat4 model = transforms[firstTransform + instance];
+
+    // world-space sphere; the radius grows with the largest scale, as rg::TransformSphere does
+    vec3 center = vec3(model * vec4(sphere.xyz, 1.0));
+    float scale2 = max(max(dot(model[0].xyz, model[0].xyz), dot(model[1].xyz, model[1].xyz)), dot(model[2].xyz, model[2].xyz));
+    float radius = sphere.w * sqrt(scale2);
+    for (int i = 0; i < 6; i++)
+        if (dot(planes[i].xyz, center) + planes[i].w < -radius)
+            return;
+    if (occlusion && occluded(center, radius))
+        return;
+
+    // the first mesh's count hands out the slot; the others count along so every command draws all survivors
+    uint slot = atomicAdd(commands[meshes[firstMesh].command].instanceCount, 1u);
+    for (int i = 1; i < meshCount; i++)
+        atomicAdd(commands[meshes[firstMesh + i].command].instanceCount, 1u);
+    for (int i = 0; i < meshCount; i++)
+    {
+        CulledMesh mesh = meshes[firstMesh + i];
+        uint record = commands[mesh.command].baseInstance + slot;
+        records[record].model = model;
+        records[record].boundsMin = mesh.boundsMin;
+        records[record].boundsExtent = mesh.boundsExtent;
+    }
+}
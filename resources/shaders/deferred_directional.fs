@@ -0,0 +1,32 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+in vec2 TexCoords;
+
+#include "uniform_blocks.glsl"
+#include "gbuffer_read.glsl"
+
+uniform bool blinnPhong;
+
+// first lighting pass of the deferred path, over the whole screen: the directional light. The point lights are
+// added on top by deferred_point.fs.
+void main()
+{
+    Surface surface = ReadGBuffer(TexCoords);
+    // nothing was drawn here; the skybox fills it in later
+    if (surface.depth == 1.0)
+        discard;
+
+    vec3 viewDir = normalize(viewPos - surface.position);
+    vec3 lightDir = normalize(-dirLight.direction);
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    float spec = SpecularTerm(surface.normal, lightDir, viewDir, surface.shininess, blinnPhong);
+
+    vec3 ambient = dirLight.ambient * surface.albedo;
+    vec3 diffuse = dirLight.diffuse * diff * surface.albedo;
+    vec3 specular = dirLight.specular * spec * surface.specular;
+    FragColor = vec4(ambient + diffuse + specular, 1.0);
+    // like the forward model shader, lit surfaces don't feed the bloom
+    BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
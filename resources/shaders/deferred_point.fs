@@ -0,0 +1,36 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+flat in vec4 PositionConstant;
+flat in vec4 AmbientLinear;
+flat in vec4 DiffuseQuadratic;
+flat in vec4 SpecularRadius;
+
+#include "uniform_blocks.glsl"
+#include "gbuffer_read.glsl"
+
+uniform bool blinnPhong;
+
+// one point light, added to what is already lit; only runs on the pixels its volume covers
+void main()
+{
+    Surface surface = ReadGBuffer(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)));
+    vec3 toLight = PositionConstant.xyz - surface.position;
+    float distance = length(toLight);
+    if (distance > SpecularRadius.w)
+        discard;
+
+    vec3 lightDir = toLight / distance;
+    vec3 viewDir = normalize(viewPos - surface.position);
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    float spec = SpecularTerm(surface.normal, lightDir, viewDir, surface.shininess, blinnPhong);
+    float attenuation = 1.0 / (PositionConstant.w + AmbientLinear.w * distance + DiffuseQuadratic.w * (distance * distance));
+
+    vec3 ambient = AmbientLinear.rgb * surface.albedo;
+    vec3 diffuse = DiffuseQuadratic.rgb * diff * surface.albedo;
+    vec3 specular = SpecularRadius.rgb * spec * surface.specular;
+    // blended additively, so nothing is added to alpha or to the bright pass
+    FragColor = vec4((ambient + diffuse + specular) * attenuation, 0.0);
+    BrightColor = vec4(0.0);
+}
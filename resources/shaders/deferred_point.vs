@@ -0,0 +1,24 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+// one light per instance: a PointLightBlock whose padding holds the radius of the light's volume
+layout (location = 1) in vec4 aPositionConstant;
+layout (location = 2) in vec4 aAmbientLinear;
+layout (location = 3) in vec4 aDiffuseQuadratic;
+layout (location = 4) in vec4 aSpecularRadius;
+
+flat out vec4 PositionConstant;
+flat out vec4 AmbientLinear;
+flat out vec4 DiffuseQuadratic;
+flat out vec4 SpecularRadius;
+
+#include "uniform_blocks.glsl"
+
+// the unit sphere around the light, scaled to the distance at which it stops contributing
+void main()
+{
+    PositionConstant = aPositionConstant;
+    AmbientLinear = aAmbientLinear;
+    DiffuseQuadratic = aDiffuseQuadratic;
+    SpecularRadius = aSpecularRadius;
+    gl_Position = projection * view * vec4(aPositionConstant.xyz + aPos * aSpecularRadius.w, 1.0);
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+// depth pre-pass: the depth test and write are all there is to it
+void main()
+{
+}
@@ -0,0 +1,28 @@
+#version 330 core
+
+in VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    mat3 TBN;
+    vec3 TangentViewPos;
+    vec3 TangentFragPos;
+} fs_in;
+
+struct Material {
+    sampler2D depthMap;
+};
+
+uniform Material material;
+uniform float heightScale;
+
+#include "parallax.glsl"
+
+// depth pre-pass of the parallax-mapped floor, with parallax_mapping.vs; it has to discard exactly where the
+// shading passes do, or the holes at the edges would keep the depth of the floor
+void main()
+{
+    vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
+    vec2 texCoords = ParallaxMapping(fs_in.TexCoords, viewDir, length(fs_in.TangentViewPos - fs_in.TangentFragPos));
+    if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
+        discard;
+}
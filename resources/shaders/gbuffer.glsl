@@ -0,0 +1,34 @@
+// G-buffer layout of the deferred path (include/learnopengl/deferred.h):
+//     attachment 0, RGBA8:    albedo, specular intensity
+//     attachment 1, RGB10_A2: octahedral normal, shininess
+//     depth, 24 bit:          world position is rebuilt from it
+// Octahedral encoding folds the unit sphere onto a square, so a normal fits two 10 bit channels with an
+// error well below what the lighting can show.
+
+vec2 octahedronWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0 ? n.xy : octahedronWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+vec3 DecodeNormal(vec2 encoded)
+{
+    vec2 f = encoded * 2.0 - 1.0;
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// shininess is stored as log2 / 11, covering exponents up to 2048
+vec4 EncodeNormalShininess(vec3 normal, float shininess)
+{
+    return vec4(EncodeNormal(normal), log2(max(shininess, 1.0)) / 11.0, 0.0);
+}
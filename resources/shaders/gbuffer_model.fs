@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormalShininess;
+
+#include "gbuffer.glsl"
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+
+    float shininess;
+};
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+
+uniform Material material;
+
+// G-buffer pass of the models, with 2.model_lighting.vs; the lighting happens in deferred_*.fs
+void main()
+{
+    gAlbedoSpec = vec4(texture(material.diffuse, TexCoords).rgb, texture(material.specular, TexCoords).r);
+    gNormalShininess = EncodeNormalShininess(normalize(Normal), material.shininess);
+}
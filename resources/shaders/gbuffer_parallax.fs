@@ -0,0 +1,44 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormalShininess;
+
+in VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    mat3 TBN;
+    vec3 TangentViewPos;
+    vec3 TangentFragPos;
+} fs_in;
+
+#include "gbuffer.glsl"
+
+struct Material {
+    sampler2D diffuseMap;
+    sampler2D depthMap;
+    sampler2D normalMap;
+
+    float shininess;
+};
+
+uniform Material material;
+uniform float heightScale;
+
+#include "parallax.glsl"
+
+// G-buffer pass of the parallax-mapped floor, with parallax_mapping.vs
+void main()
+{
+    vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
+    vec2 texCoords = ParallaxMapping(fs_in.TexCoords, viewDir, length(fs_in.TangentViewPos - fs_in.TangentFragPos));
+    if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
+        discard;
+
+    // tangent space normal from the BC5 normal map, then back to world space; TBN goes the other way
+    vec3 normal;
+    normal.xy = texture(material.normalMap, fs_in.TexCoords).rg * 2.0 - 1.0;
+    normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
+    normal = normalize(transpose(fs_in.TBN) * normal);
+
+    gAlbedoSpec = vec4(texture(material.diffuseMap, texCoords).rgb, texture(material.depthMap, texCoords).r);
+    gNormalShininess = EncodeNormalShininess(normal, material.shininess);
+}
@@ -0,0 +1,40 @@
+// reading the G-buffer in the lighting passes; see gbuffer.glsl for the layout
+
+#include "gbuffer.glsl"
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormalShininess;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+    float specular;
+    float shininess;
+    float depth;
+};
+
+Surface ReadGBuffer(vec2 uv)
+{
+    Surface surface;
+    surface.depth = texture(gDepth, uv).r;
+    vec4 clip = inverseViewProjection * vec4(vec3(uv, surface.depth) * 2.0 - 1.0, 1.0);
+    surface.position = clip.xyz / clip.w;
+    vec4 albedoSpec = texture(gAlbedoSpec, uv);
+    surface.albedo = albedoSpec.rgb;
+    surface.specular = albedoSpec.a;
+    vec4 normalShininess = texture(gNormalShininess, uv);
+    surface.normal = DecodeNormal(normalShininess.xy);
+    surface.shininess = exp2(normalShininess.z * 11.0);
+    return surface;
+}
+
+// Phong or Blinn-Phong specular term, as in the forward shaders
+float SpecularTerm(vec3 normal, vec3 lightDir, vec3 viewDir, float shininess, bool blinnPhong)
+{
+    if (blinnPhong)
+        return pow(max(dot(normal, normalize(lightDir + viewDir)), 0.0), shininess);
+    return pow(max(dot(viewDir, reflect(-lightDir, normal)), 0.0), shininess);
+}
@@ -0,0 +1,27 @@
+#version 430 core
+// One level of the Hi-Z pyramid (include/learnopengl/gpu_culling.h): every texel keeps the farthest depth of the
+// 2x2 texels of the source level it covers. When the source has an odd size, the last row and column of the
+// destination take in the source texels that would otherwise be dropped, so no depth is ever lost.
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// the depth buffer for level 0, the level above for the others
+uniform sampler2D source;
+uniform int sourceLevel;
+layout (r32f, binding = 0) writeonly uniform image2D destination;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(destination);
+    if (any(greaterThanEqual(texel, size)))
+        return;
+    ivec2 sourceSize = textureSize(source, sourceLevel);
+    ivec2 first = texel * 2;
+    ivec2 last = min(first + 1 + ivec2(equal(texel, size - 1)) * (sourceSize - size * 2), sourceSize - 1);
+
+    float depth = 0.0;
+    for (int y = first.y; y <= last.y; y++)
+        for (int x = first.x; x <= last.x; x++)
+            depth = max(depth, texelFetch(source, ivec2(x, y), sourceLevel).r);
+    imageStore(destination, texel, vec4(depth));
+}
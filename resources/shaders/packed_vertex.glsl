@@ -0,0 +1,44 @@
+// Vertex attributes of the model meshes in the PackedVertex layout (include/learnopengl/mesh.h), with the
+// functions decoding them. Mesh sets the bounds uniforms of every mesh before drawing it; the multi-draw path
+// (include/learnopengl/indirect.h) can't set uniforms between the meshes of one call and passes the bounds with
+// every instance instead.
+layout (location = 0) in vec4 aPackedPosition;
+layout (location = 1) in vec4 aPackedFrame;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 9) in vec3 aInstanceBoundsMin;
+layout (location = 10) in vec3 aInstanceBoundsExtent;
+
+uniform vec3 meshBoundsMin;
+uniform vec3 meshBoundsExtent;
+uniform bool indirect;
+
+vec3 OctahedralDecode(vec2 encoded)
+{
+    vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-direction.z, 0.0);
+    direction.x += direction.x >= 0.0 ? -fold : fold;
+    direction.y += direction.y >= 0.0 ? -fold : fold;
+    return normalize(direction);
+}
+
+vec3 VertexPosition()
+{
+    if (indirect)
+        return aInstanceBoundsMin + aPackedPosition.xyz * aInstanceBoundsExtent;
+    return meshBoundsMin + aPackedPosition.xyz * meshBoundsExtent;
+}
+
+vec3 VertexNormal()
+{
+    return OctahedralDecode(aPackedFrame.xy);
+}
+
+vec3 VertexTangent()
+{
+    return OctahedralDecode(aPackedFrame.zw);
+}
+
+vec3 VertexBitangent()
+{
+    return cross(VertexNormal(), VertexTangent()) * (aPackedPosition.w > 0.5 ? 1.0 : -1.0);
+}
@@ -0,0 +1,42 @@
+// Relief mapping by cone stepping, shared by the forward, G-buffer and depth pre-pass floor shaders. Expects
+// material.depthMap and heightScale to be declared before it is included.
+//
+// material.depthMap is a cone step map (include/learnopengl/cone_map.h): red is the depth, green the square
+// root of the ratio of radius to height of the widest cone standing on the surface there that stays clear of
+// it. A ray inside that cone can go straight to its edge without passing through the surface, so each step
+// moves as far as is safe and a few of them land next to the hit, where linear marching takes dozens of layers.
+// The cones are read from the base level, since the mips don't keep them conservative. The stored value is
+// the square root of the ratio over coneMapMaxRatio, which the program is given from CONE_MAP_MAX_RATIO.
+//
+// The effect can't be seen far away, so the offset fades out between RELIEF_FADE_START and RELIEF_FADE_END
+// (world units from the camera); beyond that the floor is only normal mapped and the march is skipped.
+
+#define RELIEF_STEPS 12
+#define RELIEF_FADE_START 6.0
+#define RELIEF_FADE_END 10.0
+
+uniform float coneMapMaxRatio;
+
+vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir, float viewDistance)
+{
+    float fade = 1.0 - smoothstep(RELIEF_FADE_START, RELIEF_FADE_END, viewDistance);
+    if (fade <= 0.0)
+        return texCoords;
+
+    // the ray in texture coordinates and depth: it moves by -P in texture space over the full depth of 1
+    vec2 P = viewDir.xy / viewDir.z * heightScale;
+    vec3 ray = vec3(texCoords, 0.0);
+    vec3 direction = vec3(-P, 1.0);
+    float spread = length(P);
+    for (int i = 0; i < RELIEF_STEPS; i++)
+    {
+        vec2 cone = textureLod(material.depthMap, ray.xy, 0.0).rg;
+        float below = cone.r - ray.z;
+        if (below <= 0.0)
+            break;
+        // depth at which the ray leaves the cone of the texel it's over
+        float ratio = cone.g * cone.g * coneMapMaxRatio;
+        ray += direction * (ratio * below / (spread + ratio));
+    }
+    return mix(texCoords, ray.xy, fade);
+}
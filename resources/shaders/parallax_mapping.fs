@@ -3,33 +3,14 @@ out vec4 FragColor;
 
 in VS_OUT {
     vec3 FragPos;
-    vec3 Normal;
     vec2 TexCoords;
-    vec3 TangentLightPos[4];
-    vec3 TangentLightDir;
+    mat3 TBN;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
 } fs_in;
 
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+#include "uniform_blocks.glsl"
+#include "clustered_lights.glsl"
 
 struct Material {
     sampler2D diffuseMap;
@@ -40,35 +21,36 @@ struct Material {
 };
 
 uniform Material material;
-uniform PointLight pointLight[4];
-uniform DirLight dirLight;
 uniform bool blinnPhong;
-uniform vec3 viewPosition;
 uniform float heightScale;
 
+#include "parallax.glsl"
+
 // function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 TangentLightDir, vec2 TexCoords);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 TangentLightPos, vec2 TexCoords);
 
-vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir);
-
 void main()
 {
     // offset texture coordinates with Parallax Mapping
     vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
     vec2 texCoords = fs_in.TexCoords;
 
-    texCoords = ParallaxMapping(fs_in.TexCoords,  viewDir);
+    texCoords = ParallaxMapping(fs_in.TexCoords, viewDir, length(fs_in.TangentViewPos - fs_in.TangentFragPos));
     if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
         discard;
 
-    // obtain normal from normal map
-    vec3 normal = texture(material.normalMap, fs_in.TexCoords).rgb;
-    normal = normalize(normal * 2.0 - 1.0);
-
-    vec3 result = CalcDirLight(dirLight, normal, viewDir, fs_in.TangentLightDir, texCoords);
-    for(int i = 0; i < 4; i++){
-        result += CalcPointLight(pointLight[i], normal, viewDir, fs_in.TangentLightPos[i], texCoords);
+    // obtain normal from normal map; it only stores x and y (BC5), z is reconstructed
+    vec3 normal;
+    normal.xy = texture(material.normalMap, fs_in.TexCoords).rg * 2.0 - 1.0;
+    normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
+    normal = normalize(normal);
+
+    vec3 result = CalcDirLight(dirLight, normal, viewDir, fs_in.TBN * dirLight.direction, texCoords);
+    uvec2 lights = ClusterLights();
+    for(uint i = 0u; i < lights.y; i++){
+        PointLight light = ClusterLight(lights.x + i);
+        result += CalcPointLight(light, normal, viewDir, fs_in.TBN * light.position, texCoords);
     }
 
     FragColor = vec4(result, 1.0);
@@ -98,7 +80,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 TangentLig
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.diffuseMap, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuseMap, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.depthMap, TexCoords));
+    vec3 specular = light.specular * spec * vec3(texture(material.depthMap, TexCoords).r);
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -125,48 +107,6 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 TangentLightDi
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.diffuseMap, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuseMap, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.depthMap, TexCoords));
+    vec3 specular = light.specular * spec * vec3(texture(material.depthMap, TexCoords).r);
     return (ambient + diffuse + specular);
 }
-
-vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
-{
-    // number of depth layers
-    const float minLayers = 8;
-    const float maxLayers = 32;
-    float numLayers = mix(maxLayers, minLayers, abs(dot(vec3(0.0, 0.0, 1.0), viewDir)));
-    // calculate the size of each layer
-    float layerDepth = 1.0 / numLayers;
-    // depth of current layer
-    float currentLayerDepth = 0.0;
-    // the amount to shift the texture coordinates per layer (from vector P)
-    vec2 P = viewDir.xy / viewDir.z * heightScale;
-    vec2 deltaTexCoords = P / numLayers;
-
-    // get initial values
-    vec2  currentTexCoords     = texCoords;
-    float currentDepthMapValue = texture(material.depthMap, currentTexCoords).r;
-
-    while(currentLayerDepth < currentDepthMapValue)
-    {
-        // shift texture coordinates along direction of P
-        currentTexCoords -= deltaTexCoords;
-        // get depthmap value at current texture coordinates
-        currentDepthMapValue = texture(material.depthMap, currentTexCoords).r;
-        // get depth of next layer
-        currentLayerDepth += layerDepth;
-    }
-
-    //get texture coordinates before collision (reverse operations)
-    vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
-
-    // get depth after and before collision for linear interpolation
-    float afterDepth  = currentDepthMapValue - currentLayerDepth;
-    float beforeDepth = texture(material.depthMap, prevTexCoords).r - currentLayerDepth + layerDepth;
-
-    // interpolation of texture coordinates
-    float weight = afterDepth / (afterDepth - beforeDepth);
-    vec2 finalTexCoords = prevTexCoords * weight + currentTexCoords * (1.0 - weight);
-
-    return finalTexCoords;
-}
\ No newline at end of file
@@ -7,21 +7,17 @@ layout (location = 4) in vec3 aBitangent;
 
 out VS_OUT {
     vec3 FragPos;
-    vec3 Normal;
     vec2 TexCoords;
-    vec3 TangentLightPos[4];
-    vec3 TangentLightDir;
+    mat3 TBN; // world to tangent space; the lights are moved into tangent space per fragment
     vec3 TangentViewPos;
     vec3 TangentFragPos;
 } vs_out;
+// same position in the depth pre-pass as in the passes shading with GL_EQUAL
+invariant gl_Position;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+#include "uniform_blocks.glsl"
 
-uniform vec3 lightPos[4];
-uniform vec3 lightDir;
-uniform vec3 viewPos;
+uniform mat4 model;
 
 void main()
 {
@@ -32,16 +28,10 @@ void main()
     vec3 B = normalize(mat3(model) * aBitangent);
     vec3 N = normalize(mat3(model) * aNormal);
     mat3 TBN = transpose(mat3(T, B, N));
-
-    for(int i = 0; i < 4; i++){
-        vs_out.TangentLightPos[i] = TBN * lightPos[i];
-    }
+    vs_out.TBN = TBN;
 
     vs_out.TangentViewPos  = TBN * viewPos;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
 
-    vs_out.Normal = aNormal;
-    vs_out.TangentLightDir = TBN * lightDir;
-
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
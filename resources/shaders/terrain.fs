@@ -0,0 +1,31 @@
+#version 330 core
+out vec4 FragColor;
+
+#include "uniform_blocks.glsl"
+#include "clustered_lights.glsl"
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+
+uniform sampler2D grass;
+
+// grass has no specular map; the terrain only takes the ambient and diffuse terms of the lights
+void main()
+{
+    vec3 color = texture(grass, TexCoords).rgb;
+    vec3 norm = normalize(Normal);
+
+    vec3 result = (dirLight.ambient + dirLight.diffuse * max(dot(norm, normalize(-dirLight.direction)), 0.0)) * color;
+    uvec2 lights = ClusterLights();
+    for(uint i = 0u; i < lights.y; i++)
+    {
+        PointLight light = ClusterLight(lights.x + i);
+        float distance = length(light.position - FragPos);
+        float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+        float diff = max(dot(norm, normalize(light.position - FragPos)), 0.0);
+        result += (light.ambient + light.diffuse * diff) * color * attenuation;
+    }
+
+    FragColor = vec4(result, 1.0);
+}
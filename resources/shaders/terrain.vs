@@ -0,0 +1,45 @@
+#version 330 core
+// one node of the CDLOD terrain (include/learnopengl/terrain.h): the shared grid placed over the node, displaced
+// by its heights and morphed into the grid of its parent towards the end of its range
+layout (location = 0) in vec2 aGrid;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+
+#include "uniform_blocks.glsl"
+
+#define TERRAIN_GRID 32.0
+
+// x and z of the node's corner and its size
+uniform vec3 nodeRect;
+// distances at which the node starts and finishes morphing into its parent's grid
+uniform vec2 morphRange;
+// (TERRAIN_GRID + 3)^2 heights, the node's vertices with a border of one
+uniform sampler2D heightMap;
+
+// height at a position on the node's grid, in vertices; between vertices it is interpolated
+float heightAt(vec2 grid)
+{
+    return textureLod(heightMap, (grid + 1.5) / (TERRAIN_GRID + 3.0), 0.0).r;
+}
+
+void main()
+{
+    vec2 grid = aGrid * TERRAIN_GRID;
+    vec2 position = nodeRect.xy + aGrid * nodeRect.z;
+    float distance = length(viewPos - vec3(position.x, heightAt(grid), position.y));
+    float morph = clamp((distance - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+    // odd vertices slide halfway towards their even neighbour, onto the grid of the next coarser level, so at
+    // the end of the range the node matches its parent and the neighbours drawn by the parent
+    grid -= fract(grid * 0.5) * 2.0 * morph;
+    position = nodeRect.xy + grid / TERRAIN_GRID * nodeRect.z;
+
+    float spacing = nodeRect.z / TERRAIN_GRID;
+    Normal = normalize(vec3(heightAt(grid - vec2(1.0, 0.0)) - heightAt(grid + vec2(1.0, 0.0)), 2.0 * spacing,
+                            heightAt(grid - vec2(0.0, 1.0)) - heightAt(grid + vec2(0.0, 1.0))));
+    FragPos = vec3(position.x, heightAt(grid), position.y);
+    // the grass repeats every four units
+    TexCoords = position / 4.0;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
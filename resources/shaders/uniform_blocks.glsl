@@ -0,0 +1,64 @@
+// Per-frame uniform blocks shared by every program; included with #include "uniform_blocks.glsl" and
+// mirrored by the std140 structs in include/rg/UniformBuffer.h, so the two have to change together.
+// Every vec3 is followed by a float to keep the std140 layout free of implicit padding.
+
+// froxel grid of the clustered point light lists (clustered_lights.glsl)
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+
+struct DirLight {
+    vec3 direction;
+    float padding0;
+    vec3 ambient;
+    float padding1;
+    vec3 diffuse;
+    float padding2;
+    vec3 specular;
+    float padding3;
+};
+
+// not part of a block; the point lights come from per-light buffers in this layout
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+    float padding;
+};
+
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 ambient;
+    float quadratic;
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
+};
+
+// binding point 0
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+// binding point 1
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    SpotLight spotLight;
+};
+
+// binding point 2
+layout (std140) uniform Clusters {
+    vec2 clusterTileScale;
+    float clusterSliceScale;
+    float clusterSliceBias;
+};
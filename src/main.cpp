@@ -9,6 +9,19 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/asset_loader.h>
+#include <learnopengl/bloom.h>
+#include <learnopengl/clustered.h>
+#include <learnopengl/deferred.h>
+#include <learnopengl/gpu_culling.h>
+#include <learnopengl/indirect.h>
+#include <learnopengl/terrain.h>
+#include <rg/Benchmark.h>
+#include <rg/Error.h>
+
+#include <imgui.h>
+#include <imgui_impl_glfw.h>
+#include <imgui_impl_opengl3.h>
 
 #include <iostream>
 
@@ -22,14 +35,20 @@ void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-unsigned int loadCubemap(vector<std::string> faces);
+void renderQuad();
 
-unsigned int loadTexture(char const * path);
+vector<glm::mat4> fenceTransforms(const vector<glm::vec3> &fences, const vector<glm::vec3> &fencesRotated, bool gateClosed);
 
-void renderQuad();
+rg::LightsBlock sceneLights();
+
+vector<rg::PointLightBlock> villageLamps(const glm::vec3 *positions, int count);
+
+vector<rg::PointLightBlock> hutLamps(const vector<glm::vec3> &huts, const vector<glm::vec3> &hutsRotated);
 
 void renderQuadForBloom();
 
+void DrawProfilerOverlay(const rg::GpuProfiler &profiler);
+
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
@@ -40,6 +59,12 @@ float heightScale = 0.0305f;
 bool bloom = false;
 bool bloomKeyPressed = false;
 float exposure = 1.0f;
+bool profilerOverlay = false;
+bool deferred = false;
+bool depthPrepass = false;
+bool multiDraw = false;
+bool gpuCulling = false;
+bool hiZOcclusion = true;
 
 // camera
 Camera camera(glm::vec3(-6.0f, 7.0f, -9.0f));
@@ -51,17 +76,59 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main() {
+int main(int argc, char **argv) {
+    // with -DRG_PROFILE=ON every load phase and frame section is recorded and written to trace.json on exit
+    RG_PROFILE_THREAD("main");
+
+    // --benchmark replays a camera path offscreen and writes frame and pass timings (see rg/Benchmark.h)
+    // --------------------------------------------------------------------------------------------------
+    rg::BenchmarkOptions benchmark;
+    if (!benchmark.Parse(argc, argv))
+        return -1;
+    rg::CameraPath cameraPath;
+    if (benchmark.enabled)
+    {
+        if (!cameraPath.Load(benchmark.cameraPath))
+            return -1;
+        if (benchmark.frames == 0)
+            benchmark.frames = cameraPath.LastFrame() + 1;
+        // every pass gets measured
+        bloom = true;
+        deferred = benchmark.deferred;
+        depthPrepass = benchmark.depthPrepass;
+        multiDraw = benchmark.multiDraw;
+        gpuCulling = benchmark.gpuCulling;
+        hiZOcclusion = !benchmark.noHiZ;
+    }
+
     // glfw: initialize and configure
     // ------------------------------
+    RG_PROFILE_BEGIN(context, "create context");
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+    // without a display server (CI hosts) the benchmark uses GLFW's null platform and renders through OSMesa
+    if (benchmark.enabled && !getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY"))
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (benchmark.enabled)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+        if (glfwGetPlatform() == GLFW_PLATFORM_NULL)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+    }
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+#ifdef RG_GL_DEBUG
+    // some drivers only report through the debug callback in a debug context, which may run slower
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
 
     // glfw window creation
     // --------------------
@@ -78,7 +145,8 @@ int main() {
     glfwSetKeyCallback(window, key_callback);
 
     // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!benchmark.enabled)
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
@@ -86,10 +154,92 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // GL errors are reported by the driver through a callback (see rg/Error.h) where it supports that
+#ifdef RG_GL_DEBUG
+    rg::enableGLDebugOutput((GLADloadproc) glfwGetProcAddress, GL_DEBUG_SEVERITY_LOW);
+#else
+    rg::enableGLDebugOutput((GLADloadproc) glfwGetProcAddress);
+#endif
+    // the benchmark measures how fast frames can be rendered, not the display's refresh rate
+    if (benchmark.enabled)
+        glfwSwapInterval(0);
+
+    // ImGui, for the profiler overlay; its GLFW callbacks are chained in front of ours
+    // -------------------------------------------------------------------------------
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGui::GetIO().IniFilename = NULL;
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 330 core");
+    RG_PROFILE_END(context);
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(false);
 
+    // textures are block compressed into the formats this driver can sample
+    DetectTextureCompression();
+
+    // start loading assets: imports and image decodes run on worker threads while the shaders and framebuffers
+    // below are set up, the GL uploads happen in loader.Finish()
+    // ---------------------------------------------------------------------------------------------------------
+    RG_PROFILE_BEGIN(queueAssets, "queue assets");
+    AssetLoader loader;
+
+    // load textures
+    // .............
+    unsigned int transparentTexture, floorDiffuseMap, floorSpecularMap;
+    loader.LoadTexture(transparentTexture, FileSystem::getPath("resources/textures/tree.png"));
+    loader.LoadTexture(floorDiffuseMap, FileSystem::getPath("resources/textures/grass/diffuse.png"));
+    loader.LoadTexture(floorSpecularMap, FileSystem::getPath("resources/textures/grass/specular.png"));
+
+    unsigned int pDiffuseMap, pNormalMap, pHeightMap;
+    loader.LoadTexture(pDiffuseMap, FileSystem::getPath("resources/textures/grassD.jpg"));
+    loader.LoadTexture(pNormalMap, FileSystem::getPath("resources/textures/grassN.jpg"), TEXTURE_NORMAL);
+    // relief mapped through a cone step map built from the height map on the first run, then read from its cache
+    loader.LoadTexture(pHeightMap, FileSystem::getPath("resources/textures/grassH.jpg"), TEXTURE_CONE_MAP);
+
+    // skybox textures
+    vector<std::string> skyboxSides = {
+            FileSystem::getPath("resources/textures/alps/right.tga"),
+            FileSystem::getPath("resources/textures/alps/left.tga"),
+            FileSystem::getPath("resources/textures/alps/up.tga"),
+            FileSystem::getPath("resources/textures/alps/down.tga"),
+            FileSystem::getPath("resources/textures/alps/back.tga"),
+            FileSystem::getPath("resources/textures/alps/front.tga")
+    };
+    unsigned int cubemapTexture;
+    loader.LoadCubemap(cubemapTexture, skyboxSides);
+
+    // load models
+    // -----------
+    Model ufoModel;
+    loader.LoadModel(ufoModel, "resources/objects/ufo/Low_poly_UFO.obj");
+    ufoModel.SetShaderTextureNamePrefix("material.");
+
+    Model stallModel;
+    loader.LoadModel(stallModel, "resources/objects/proba/model/silo.obj");
+    stallModel.SetShaderTextureNamePrefix("material.");
+
+    Model hutModel;
+    loader.LoadModel(hutModel, "resources/objects/hut/woodshed.obj");
+    hutModel.SetShaderTextureNamePrefix("material.");
+
+    Model wellModel;
+    loader.LoadModel(wellModel, "resources/objects/well/well.obj");
+    wellModel.SetShaderTextureNamePrefix("material.");
+
+    Model fenceModel;
+    loader.LoadModel(fenceModel, "resources/objects/fence/fence wood.obj");
+    fenceModel.SetShaderTextureNamePrefix("material.");
+
+    Model sheepModel;
+    loader.LoadModel(sheepModel, "resources/objects/sheep/sheep01.obj");
+    sheepModel.SetShaderTextureNamePrefix("material.");
+
+    Model humanModel;
+    loader.LoadModel(humanModel, "resources/objects/human/human.obj");
+    humanModel.SetShaderTextureNamePrefix("material.");
+    RG_PROFILE_END(queueAssets);
 
     // configure global opengl state
     // -----------------------------
@@ -97,16 +247,23 @@ int main() {
 
     // build and compile shaders
     // -------------------------
-    Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
-    Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
-    Shader blendingShader("resources/shaders/blending.vs", "resources/shaders/blending.fs");
-    Shader shader("resources/shaders/parallax_mapping.vs", "resources/shaders/parallax_mapping.fs");
-
-    Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
-    Shader bloomFinalShader("resources/shaders/bloom_final.vs", "resources/shaders/bloom_final.fs");
-    Shader ufoShader("resources/shaders/bloomSpotLight.vs", "resources/shaders/bloomSpotLight.fs");
+    RG_PROFILE_BEGIN(compileShaders, "compile shaders");
+    Shader ourShader = AcquireShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+    Shader skyboxShader = AcquireShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
+    Shader blendingShader = AcquireShader("resources/shaders/blending.vs", "resources/shaders/blending.fs");
+    Shader shader = AcquireShader("resources/shaders/parallax_mapping.vs", "resources/shaders/parallax_mapping.fs");
+
+    Shader bloomFinalShader = AcquireShader("resources/shaders/bloom_final.vs", "resources/shaders/bloom_final.fs");
+    // G-buffer versions of the model and floor shaders, for the deferred path
+    Shader gBufferShader = AcquireShader("resources/shaders/2.model_lighting.vs", "resources/shaders/gbuffer_model.fs");
+    Shader gBufferFloorShader = AcquireShader("resources/shaders/parallax_mapping.vs", "resources/shaders/gbuffer_parallax.fs");
+    // depth-only versions of the model and floor shaders, for the depth pre-pass
+    Shader depthShader = AcquireShader("resources/shaders/2.model_lighting.vs", "resources/shaders/depth_only.fs");
+    Shader depthFloorShader = AcquireShader("resources/shaders/parallax_mapping.vs", "resources/shaders/depth_parallax.fs");
+    RG_PROFILE_END(compileShaders);
 
     // skybox vertices
+    RG_PROFILE_BEGIN(createBuffers, "create buffers");
     float skyboxVertices[] = {
             // positions
             -1.0f,  1.0f, -1.0f,
@@ -162,6 +319,9 @@ int main() {
             1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
             1.0f,  0.5f,  0.0f,  1.0f,  0.0f
     };
+    // bounding sphere of the quad above, for culling
+    const glm::vec3 vegetationCenter(0.5f, 0.0f, 0.0f);
+    const float vegetationRadius = 0.7072f;
 
     glm::vec3 pointLightPositions[] = {
             glm::vec3( 0.7f,  0.2f,  2.0f),
@@ -218,7 +378,8 @@ int main() {
     unsigned int rboDepth;
     glGenRenderbuffers(1, &rboDepth);
     glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
+    // sized to match the G-buffer depth, which the deferred path copies in here
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, SCR_WIDTH, SCR_HEIGHT);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
     // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
     unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
@@ -228,59 +389,45 @@ int main() {
         std::cout << "Framebuffer not complete!" << std::endl;
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
-    // load textures
-    // .............
-
-    unsigned int transparentTexture = loadTexture(FileSystem::getPath("resources/textures/tree.png").c_str());
-    unsigned int floorDiffuseMap = loadTexture(FileSystem::getPath("resources/textures/grass/diffuse.png").c_str());
-    unsigned int floorSpecularMap = loadTexture(FileSystem::getPath("resources/textures/grass/specular.png").c_str());
-
-    unsigned int pDiffuseMap = loadTexture(FileSystem::getPath("resources/textures/grassD.jpg").c_str());
-    unsigned int pNormalMap = loadTexture(FileSystem::getPath("resources/textures/grassN.jpg").c_str());
-    unsigned int pHeightMap = loadTexture(FileSystem::getPath("resources/textures/grassH.jpg").c_str());
+    // downsample/upsample chain that blurs the bright pass
+    BloomMipChain bloomChain(SCR_WIDTH, SCR_HEIGHT);
+
+    // G-buffer and light volumes of the deferred path (F4); it shades into hdrFBO like the forward path
+    DeferredRenderer deferredRenderer(SCR_WIDTH, SCR_HEIGHT);
+    // per-cluster point light lists of the forward shaders, rebuilt every frame
+    ClusteredLights clusteredLights(SCR_WIDTH, SCR_HEIGHT);
+    // hills around the village, streamed in around the camera
+    Terrain terrain;
+    // the opaque models as multi-draw indirect commands (F6); a loop over the commands where GL 4.3 is missing
+    IndirectRenderer indirectRenderer((GLADloadproc) glfwGetProcAddress);
+    Shader *clusteredShaders[] = { &ourShader, &shader, &blendingShader, &terrain.GetShader() };
+    for (Shader *clustered : clusteredShaders)
+        clusteredLights.SetSamplers(*clustered);
 
     ourShader.use();
     ourShader.setInt("material.diffuse", 0);
     ourShader.setInt("material.specular", 1);
 
-    ufoShader.use();
-    ufoShader.setInt("material.diffuse", 0);
-    ufoShader.setInt("material.specular", 1);
+    gBufferShader.use();
+    gBufferShader.setInt("material.diffuse", 0);
+    gBufferShader.setInt("material.specular", 1);
 
     shader.use();
     shader.setInt("material.diffuseMap", 0);
     shader.setInt("material.normalMap", 1);
     shader.setInt("material.depthMap", 2);
+    shader.setFloat("coneMapMaxRatio", CONE_MAP_MAX_RATIO);
+
+    gBufferFloorShader.use();
+    gBufferFloorShader.setInt("material.diffuseMap", 0);
+    gBufferFloorShader.setInt("material.normalMap", 1);
+    gBufferFloorShader.setInt("material.depthMap", 2);
+    gBufferFloorShader.setFloat("coneMapMaxRatio", CONE_MAP_MAX_RATIO);
+
+    depthFloorShader.use();
+    depthFloorShader.setInt("material.depthMap", 2);
+    depthFloorShader.setFloat("coneMapMaxRatio", CONE_MAP_MAX_RATIO);
 
-    // skybox textures
-    vector<std::string> skyboxSides = {
-            FileSystem::getPath("resources/textures/alps/right.tga"),
-            FileSystem::getPath("resources/textures/alps/left.tga"),
-            FileSystem::getPath("resources/textures/alps/up.tga"),
-            FileSystem::getPath("resources/textures/alps/down.tga"),
-            FileSystem::getPath("resources/textures/alps/back.tga"),
-            FileSystem::getPath("resources/textures/alps/front.tga")
-    };
-    unsigned int cubemapTexture = loadCubemap(skyboxSides);
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
@@ -337,40 +484,19 @@ int main() {
 
     // bloom shaders configuration
     // ---------------------------
-    blurShader.use();
-    blurShader.setInt("image", 0);
     bloomFinalShader.use();
     bloomFinalShader.setInt("scene", 0);
     bloomFinalShader.setInt("bloomBlur", 1);
+    bloomFinalShader.setFloat("bloomStrength", bloomChain.Normalization());
+    RG_PROFILE_END(createBuffers);
 
-    //before loading model
-    stbi_set_flip_vertically_on_load(false);
-
-    // load models
-    // -----------
-    Model ufoModel("resources/objects/ufo/Low_poly_UFO.obj");
-    ufoModel.SetShaderTextureNamePrefix("material.");
-
-    Model stallModel("resources/objects/proba/model/silo.obj");
-    stallModel.SetShaderTextureNamePrefix("material.");
-
-    Model hutModel("resources/objects/hut/woodshed.obj");
-    hutModel.SetShaderTextureNamePrefix("material.");
-
-    Model wellModel("resources/objects/well/well.obj");
-    wellModel.SetShaderTextureNamePrefix("material.");
-
-    Model fenceModel("resources/objects/fence/fence wood.obj");
-    fenceModel.SetShaderTextureNamePrefix("material.");
-
-    Model sheepModel("resources/objects/sheep/sheep01.obj");
-    sheepModel.SetShaderTextureNamePrefix("material.");
-
-    Model humanModel("resources/objects/human/human.obj");
-    humanModel.SetShaderTextureNamePrefix("material.");
+    // wait for the asset loader to finish decoding and uploading everything requested above
+    // -------------------------------------------------------------------------------------
+    loader.Finish();
 
     // coords for models
     // -----------------
+    RG_PROFILE_BEGIN(placeProps, "place props");
     vector <glm::vec3> stalls =
             {
                     glm::vec3(10.5f, 0.0f, 11.0f),
@@ -474,492 +600,527 @@ int main() {
                     glm::vec3(5.5f, 0.0f, -7.0f)
             };
 
+    // human models: position and rotation around the model's own up axis
+    vector<std::pair<glm::vec3, float>> humans =
+            {
+                    {glm::vec3(-6.0f, 0.0f, 8.0f), 0.0f},
+                    {glm::vec3(-8.0f, 0.0f, 8.0f), -45.0f},
+                    {glm::vec3(-8.0f, 0.0f, 6.5f), 180.0f},
+                    {glm::vec3(-6.0f, 0.0f, 6.5f), 135.0f},
+                    {glm::vec3(-6.0f, 0.0f, -6.5f), 0.0f},
+                    {glm::vec3(-8.0f, 0.0f, -6.5f), -45.0f},
+                    {glm::vec3(-8.0f, 0.0f, -8.0f), 180.0f},
+                    {glm::vec3(-6.0f, 0.0f, -8.0f), 135.0f},
+                    {glm::vec3(-6.0f, 0.0f, 1.5f), 0.0f},
+                    {glm::vec3(-8.0f, 0.0f, 1.5f), -45.0f},
+                    {glm::vec3(-8.0f, 0.0f, -1.5f), 180.0f},
+                    {glm::vec3(-6.0f, 0.0f, -1.5f), 135.0f}
+            };
+
+    // per-instance transforms of the repeated props
+    // ---------------------------------------------
+    vector<glm::mat4> transforms;
+    glm::mat4 model;
+
+    for (const glm::vec3 &position : stalls)
+    {
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, position);
+        model = glm::scale(model, glm::vec3(0.1f));
+        transforms.push_back(model);
+    }
+    CulledInstances stallInstances;
+    stallInstances.Set(transforms, stallModel.Bounds());
+
+    transforms.clear();
+    for (const glm::vec3 &position : hutsRotated)
+    {
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, position);
+        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.005f));
+        transforms.push_back(model);
+    }
+    for (const glm::vec3 &position : huts)
+    {
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, position);
+        model = glm::scale(model, glm::vec3(0.005f));
+        transforms.push_back(model);
+    }
+    CulledInstances hutInstances;
+    hutInstances.Set(transforms, hutModel.Bounds());
+
+    transforms.clear();
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(1.0f, 0.0f, 0.0f));
+    model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    model = glm::scale(model, glm::vec3(0.009f));
+    transforms.push_back(model);
+    for (const auto &human : humans)
+    {
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, human.first);
+        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        if (human.second != 0.0f)
+            model = glm::rotate(model, glm::radians(human.second), glm::vec3(0.0f, 0.0f, 1.0f));
+        model = glm::scale(model, glm::vec3(0.009f));
+        transforms.push_back(model);
+    }
+    CulledInstances humanInstances;
+    humanInstances.Set(transforms, humanModel.Bounds());
+
+    CulledInstances fenceInstances;
+    fenceInstances.Set(fenceTransforms(fences, fencesRotated, gateClosed), fenceModel.Bounds());
+    bool fenceInstancesGateClosed = gateClosed;
+
+    transforms.clear();
+    for (const glm::vec3 &position : sheepsInside)
+    {
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, position);
+        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.6f));
+        transforms.push_back(model);
+    }
+    for (unsigned int i = 0; i < sheepsOutside.size(); i++)
+    {
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, sheepsOutside[i]);
+        model = glm::rotate(model, glm::radians(15.0f * (float)pow(-1, i) * i), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.6f));
+        transforms.push_back(model);
+    }
+    CulledInstances sheepInstances;
+    sheepInstances.Set(transforms, sheepModel.Bounds());
+
+    // the same fields culled by a compute pass (F7), where GL 4.3 is there for it
+    GpuCulling gpuCuller((GLADloadproc) glfwGetProcAddress, SCR_WIDTH, SCR_HEIGHT);
+    gpuCuller.AddField(stallModel, stallInstances.Transforms());
+    gpuCuller.AddField(hutModel, hutInstances.Transforms());
+    gpuCuller.AddField(humanModel, humanInstances.Transforms());
+    unsigned int fenceField = gpuCuller.AddField(fenceModel, fenceInstances.Transforms());
+    gpuCuller.AddField(sheepModel, sheepInstances.Transforms());
+
+    // per-frame uniform blocks shared by every program (resources/shaders/uniform_blocks.glsl)
+    rg::UniformBuffer<rg::CameraBlock> cameraBuffer(rg::CAMERA_BLOCK_BINDING);
+    rg::UniformBuffer<rg::LightsBlock> lightsBuffer(rg::LIGHTS_BLOCK_BINDING);
+    rg::LightsBlock lights = sceneLights();
+    // the point lights aren't in the Lights block; both paths only shade each fragment with the lights near it
+    vector<rg::PointLightBlock> pointLights = villageLamps(pointLightPositions, 4);
+    vector<rg::PointLightBlock> lamps = hutLamps(huts, hutsRotated);
+    pointLights.insert(pointLights.end(), lamps.begin(), lamps.end());
+    deferredRenderer.SetPointLights(pointLights);
+    clusteredLights.SetPointLights(pointLights);
+
+    // uniforms set for every object or pass, resolved once
+    rg::Uniform<glm::mat4> ourModel = ourShader.uniform<glm::mat4>("model");
+    rg::Uniform<bool> ourInstanced = ourShader.uniform<bool>("instanced");
+    rg::Uniform<bool> ourIndirect = ourShader.uniform<bool>("indirect");
+    rg::Uniform<glm::mat4> gBufferModel = gBufferShader.uniform<glm::mat4>("model");
+    rg::Uniform<bool> gBufferInstanced = gBufferShader.uniform<bool>("instanced");
+    rg::Uniform<bool> gBufferIndirect = gBufferShader.uniform<bool>("indirect");
+    rg::Uniform<glm::mat4> depthModel = depthShader.uniform<glm::mat4>("model");
+    rg::Uniform<bool> depthInstanced = depthShader.uniform<bool>("instanced");
+    rg::Uniform<bool> depthIndirect = depthShader.uniform<bool>("indirect");
+    rg::Uniform<glm::mat4> blendingModel = blendingShader.uniform<glm::mat4>("model");
+    RG_PROFILE_END(placeProps);
+
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+    // GPU and CPU time of every pass, shown by the profiler overlay (F3) and reported by the benchmark
+    enum { PASS_DEPTH_PREPASS, PASS_SCENE, PASS_PARALLAX_FLOOR, PASS_LIGHTING, PASS_TERRAIN, PASS_SKYBOX, PASS_VEGETATION, PASS_BLOOM, PASS_COMPOSITE };
+    rg::GpuProfiler profiler({"depth pre-pass", "scene", "parallax floor", "lighting", "terrain", "skybox", "vegetation", "bloom", "composite"});
+    profiler.KeepSamples(benchmark.enabled);
+    rg::BenchmarkReport report(benchmark);
+    rg::CameraPath recordedPath;
+    uint64_t frame = 0;
+    double previousSwap = glfwGetTime();
+
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window)) {
+    while (!glfwWindowShouldClose(window) && !(benchmark.enabled && frame >= benchmark.frames)) {
+        RG_PROFILE_ZONE("frame");
         // per-frame time logic
         // --------------------
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        // the benchmark steps the scene by a fixed timestep, so every run renders exactly the same frames
+        float sceneTime = currentFrame;
+        if (benchmark.enabled)
+        {
+            deltaTime = benchmark.timestep;
+            sceneTime = frame * benchmark.timestep;
+        }
 
         // input
         // -----
-        processInput(window);
-
-        if(cursorEnabled)
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+        RG_PROFILE_BEGIN(input, "input");
+        if (benchmark.enabled)
+        {
+            rg::CameraKey key = cameraPath.Sample(frame);
+            camera.Set(key.position, key.yaw, key.pitch, key.zoom);
+        }
         else
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        {
+            processInput(window);
+
+            if(cursorEnabled)
+                glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+            else
+                glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        }
+        if (!benchmark.record.empty())
+        {
+            rg::CameraKey key;
+            key.frame = frame;
+            key.position = camera.Position;
+            key.yaw = camera.Yaw;
+            key.pitch = camera.Pitch;
+            key.zoom = camera.Zoom;
+            recordedPath.Add(key);
+        }
+        RG_PROFILE_END(input);
 
         // render
         // ------
+        // whatever ran since the last frame may have bound things past the state cache
+        RG_PROFILE_BEGIN(frameSetup, "frame setup");
+        rg::State().Invalidate();
+        profiler.BeginFrame(frame);
         glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        //render scene into floating point framebuffer
-        // -----------------------------------------------BLOOM
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        ufoShader.use();
-        ufoShader.setVec3("viewPosition", camera.Position);
-        ufoShader.setFloat("material.shininess", 16.0f);
-
-        // spotlight
-        ufoShader.setVec3("spotLight.position", glm::vec3(10 * cos(glfwGetTime()/2), 7.0f, 10 * sin(glfwGetTime()/2)));
-        ufoShader.setVec3("spotLight.direction", glm::vec3(0.0f, -1.0f, 0.0f));
-        ufoShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        ufoShader.setVec3("spotLight.diffuse", 0.1f, 0.1f, 0.1f);
-        ufoShader.setVec3("spotLight.specular", 0.1f, 0.1f, 0.1f);
-        ufoShader.setFloat("spotLight.constant", 1.0f);
-        ufoShader.setFloat("spotLight.linear", 1.0f);
-        ufoShader.setFloat("spotLight.quadratic", 1.0f);
-        ufoShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        ufoShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-
-        // don't forget to enable shader before setting uniforms
-        ourShader.use();
-        ourShader.setVec3("viewPos", camera.Position);
-        ourShader.setFloat("material.shininess", 16.0f);
-        ourShader.setInt("blinnPhong", blinnPhong);
-
-        // directional light
-        ourShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        ourShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        ourShader.setVec3("dirLight.diffuse", 0.1f, 0.1f, 0.1f);
-        ourShader.setVec3("dirLight.specular", 0.1f, 0.1f, 0.1f);
-        // point light 1
-        ourShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-        ourShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        ourShader.setVec3("pointLights[0].diffuse", 0.1f, 0.1f, 0.1f);
-        ourShader.setVec3("pointLights[0].specular", 0.1f, 0.1f, 0.1f);
-        ourShader.setFloat("pointLights[0].constant", 1.0f);
-        ourShader.setFloat("pointLights[0].linear", 0.09);
-        ourShader.setFloat("pointLights[0].quadratic", 0.032);
-        // point light 2
-        ourShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-        ourShader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-        ourShader.setVec3("pointLights[1].diffuse", 0.1f, 0.1f, 0.1f);
-        ourShader.setVec3("pointLights[1].specular", 0.1f, 0.1f, 0.1f);
-        ourShader.setFloat("pointLights[1].constant", 1.0f);
-        ourShader.setFloat("pointLights[1].linear", 0.09);
-        ourShader.setFloat("pointLights[1].quadratic", 0.032);
-        // point light 3
-        ourShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-        ourShader.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-        ourShader.setVec3("pointLights[2].diffuse", 0.1f, 0.1f, 0.1f);
-        ourShader.setVec3("pointLights[2].specular", 0.1f, 0.1f, 0.1f);
-        ourShader.setFloat("pointLights[2].constant", 1.0f);
-        ourShader.setFloat("pointLights[2].linear", 0.09);
-        ourShader.setFloat("pointLights[2].quadratic", 0.032);
-        // point light 4
-        ourShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-        ourShader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-        ourShader.setVec3("pointLights[3].diffuse", 0.1f, 0.1f, 0.1f);
-        ourShader.setVec3("pointLights[3].specular", 0.1f, 0.1f, 0.1f);
-        ourShader.setFloat("pointLights[3].constant", 1.0f);
-        ourShader.setFloat("pointLights[3].linear", 0.09);
-        ourShader.setFloat("pointLights[3].quadratic", 0.032);
-
-        // view/projection transformations
+        // camera and lights are uploaded once per frame and read by every program through their uniform blocks
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 2000.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-        ufoShader.setMat4("projection", projection);
-        ufoShader.setMat4("view", view);
-        // render the loaded models
-
-        // ufo model
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model,
-                               glm::vec3(10 * cos(glfwGetTime()/2), 7.0f, 10 * sin(glfwGetTime()/2))); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(0.05f));    // it's a bit too big for our scene, so scale it down
-        ufoShader.setMat4("model", model);
-        ufoModel.Draw(ufoShader);
-
-        // stall model
-        for(unsigned int i = 0; i < stalls.size(); i++)
+        rg::CameraBlock cameraBlock;
+        cameraBlock.projection = projection;
+        cameraBlock.view = view;
+        cameraBlock.viewPos = camera.Position;
+        cameraBuffer.Upload(cameraBlock);
+        // everything entirely outside of it is skipped before it is submitted
+        rg::Frustum frustum(projection * view);
+
+        // the UFO's spotlight follows it around its orbit
+        glm::vec3 ufoPosition(10 * cos(sceneTime/2), 7.0f, 10 * sin(sceneTime/2));
+        lights.spotLight.position = ufoPosition;
+        lightsBuffer.Upload(lights);
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, stalls[i]);
-            model = glm::scale(model, glm::vec3(0.1f));
-            ourShader.setMat4("model", model);
-            stallModel.Draw(ourShader);
+            RG_PROFILE_ZONE("light clusters");
+            clusteredLights.Update(view, projection);
         }
+        terrain.Update(camera.Position, frustum);
 
-        // hut model
-        for(unsigned int i = 0; i < hutsRotated.size(); i ++)
+        // the gate changes which fence pieces are drawn, so the fence instances are rebuilt when it is toggled
+        if (fenceInstancesGateClosed != gateClosed)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, hutsRotated[i]);
-            model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.005f));
-            ourShader.setMat4("model", model);
-            hutModel.Draw(ourShader);
+            fenceInstances.Set(fenceTransforms(fences, fencesRotated, gateClosed), fenceModel.Bounds());
+            gpuCuller.SetField(fenceField, fenceInstances.Transforms());
+            fenceInstancesGateClosed = gateClosed;
         }
+        RG_PROFILE_END(frameSetup);
 
-        for(unsigned int i = 0; i < huts.size(); i++){
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, huts[i]);
-            model = glm::scale(model, glm::vec3(0.005f));
-            ourShader.setMat4("model", model);
-            hutModel.Draw(ourShader);
+        //render scene into floating point framebuffer; the deferred path draws the opaque geometry into its
+        // G-buffer first and shades that into the framebuffer
+        // -----------------------------------------------BLOOM
+        if (deferred)
+            deferredRenderer.BeginGeometry();
+        else
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+        Shader &modelShader = deferred ? gBufferShader : ourShader;
+        rg::Uniform<glm::mat4> modelUniform = deferred ? gBufferModel : ourModel;
+        rg::Uniform<bool> instancedUniform = deferred ? gBufferInstanced : ourInstanced;
+        rg::Uniform<bool> indirectUniform = deferred ? gBufferIndirect : ourIndirect;
+        Shader &floorShader = deferred ? gBufferFloorShader : shader;
+
+        // repeated props: the instance buffers keep only what is in view, then one instanced draw call per mesh;
+        // on the GPU the CPU doesn't touch a single instance
+        bool cullOnGpu = gpuCulling && gpuCuller.Supported();
+        if (cullOnGpu)
+        {
+            RG_PROFILE_ZONE("gpu culling");
+            gpuCuller.Cull(projection * view, hiZOcclusion);
+        }
+        else
+        {
+            stallInstances.Cull(frustum);
+            hutInstances.Cull(frustum);
+            humanInstances.Cull(frustum);
+            fenceInstances.Cull(frustum);
+            sheepInstances.Cull(frustum);
         }
 
-        // human model
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-6.0f, 0.0f, 8.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-8.0f, 0.0f, 8.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(-45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-8.0f, 0.0f, 6.5f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-6.0f, 0.0f, 6.5f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(135.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-6.0f, 0.0f, -6.5f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-8.0f, 0.0f, -6.5f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(-45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-8.0f, 0.0f, -8.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-6.0f, 0.0f, -8.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(135.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-6.0f, 0.0f, 1.5f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-8.0f, 0.0f, 1.5f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(-45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-8.0f, 0.0f, -1.5f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-6.0f, 0.0f, -1.5f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(135.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, glm::vec3(0.009f));
-        ourShader.setMat4("model", model);
-        humanModel.Draw(ourShader);
+        glm::mat4 ufoTransform = glm::mat4(1.0f);
+        ufoTransform = glm::translate(ufoTransform, ufoPosition);
+        ufoTransform = glm::scale(ufoTransform, glm::vec3(0.05f));    // it's a bit too big for our scene, so scale it down
+        glm::mat4 wellTransform = glm::mat4(1.0f);
+        wellTransform = glm::translate(wellTransform, glm::vec3(4.0f, 0.0f, 0.0f));
+        wellTransform = glm::scale(wellTransform, glm::vec3(0.15f));
+        if (multiDraw)
+        {
+            RG_PROFILE_ZONE("build draw commands");
+            indirectRenderer.Begin();
+            indirectRenderer.Add(ufoModel, ufoTransform, frustum);
+            if (!cullOnGpu)
+            {
+                indirectRenderer.Add(stallModel, stallInstances.VisibleTransforms());
+                indirectRenderer.Add(hutModel, hutInstances.VisibleTransforms());
+                indirectRenderer.Add(humanModel, humanInstances.VisibleTransforms());
+                indirectRenderer.Add(fenceModel, fenceInstances.VisibleTransforms());
+                indirectRenderer.Add(sheepModel, sheepInstances.VisibleTransforms());
+            }
+            indirectRenderer.Add(wellModel, wellTransform, frustum);
+            indirectRenderer.Upload();
+        }
 
-        // well model
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(4.0f, 0.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.15f));
-        ourShader.setMat4("model", model);
-        wellModel.Draw(ourShader);
+        // the opaque geometry, drawn the same way by the depth pre-pass and the passes that shade it
+        auto drawModels = [&](Shader &program, rg::Uniform<glm::mat4> programModel, rg::Uniform<bool> programInstanced,
+                              rg::Uniform<bool> programIndirect)
+        {
+            if (cullOnGpu)
+            {
+                program.set(programInstanced, true);
+                program.set(programIndirect, true);
+                gpuCuller.Draw(program);
+                program.set(programIndirect, false);
+                program.set(programInstanced, false);
+            }
+
+            if (multiDraw)
+            {
+                program.set(programInstanced, true);
+                program.set(programIndirect, true);
+                indirectRenderer.Draw(program);
+                program.set(programIndirect, false);
+                program.set(programInstanced, false);
+                return;
+            }
+
+            // ufo model
+            program.set(programModel, ufoTransform);
+            ufoModel.Draw(program, frustum, ufoTransform);
+
+            if (!cullOnGpu)
+            {
+                program.set(programInstanced, true);
+                stallModel.DrawInstanced(program, stallInstances.buffer);
+                hutModel.DrawInstanced(program, hutInstances.buffer);
+                humanModel.DrawInstanced(program, humanInstances.buffer);
+                fenceModel.DrawInstanced(program, fenceInstances.buffer);
+                sheepModel.DrawInstanced(program, sheepInstances.buffer);
+                program.set(programInstanced, false);
+            }
+
+            // well model
+            program.set(programModel, wellTransform);
+            wellModel.Draw(program, frustum, wellTransform);
+        };
+        auto drawFloor = [&](Shader &program)
+        {
+            // render parallax-mapped quad
+            glm::mat4 model1 = glm::mat4(1.0f);
+            model1 = glm::translate(model1, glm::vec3(0.0f, 0.0f, 0.0f));
+            model1 = glm::rotate(model1, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+            model1 = glm::scale(model1, glm::vec3(12.5f));
+            program.setMat4("model", model1);
+            program.setFloat("heightScale", heightScale); // adjust with Q and E keys
+            rg::State().BindTexture(0, GL_TEXTURE_2D, pDiffuseMap);
+            rg::State().BindTexture(1, GL_TEXTURE_2D, pNormalMap);
+            rg::State().BindTexture(2, GL_TEXTURE_2D, pHeightMap);
+            glEnable(GL_CULL_FACE);     // floor won't be visible if looked from bellow
+            glCullFace(GL_BACK);
+            renderQuad();
+            glDisable(GL_CULL_FACE);
+        };
 
-        // fence model
-        for(unsigned int i = 0; i < fences.size(); i++)
+        // With the pre-pass the opaque geometry only lays down depth first, and is then shaded where its depth
+        // is the one left in the buffer, so every pixel runs the expensive shaders once however the models
+        // overlap. It pays for itself when overdraw costs more than drawing everything twice.
+        if (depthPrepass)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, fences[i]);
-            model = glm::scale(model, glm::vec3(0.8f));
-            ourShader.setMat4("model", model);
-            fenceModel.Draw(ourShader);
+            rg::GpuProfiler::Zone zone(profiler, PASS_DEPTH_PREPASS);
+            RG_PROFILE_ZONE("depth pre-pass");
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            depthShader.use();
+            drawModels(depthShader, depthModel, depthInstanced, depthIndirect);
+            depthFloorShader.use();
+            drawFloor(depthFloorShader);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
         }
 
-        for(unsigned int i = 0; i < fencesRotated.size(); i ++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, fencesRotated[i]);
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.8f));
-            ourShader.setMat4("model", model);
-            fenceModel.Draw(ourShader);
+        {
+            rg::GpuProfiler::Zone zone(profiler, PASS_SCENE);
+            RG_PROFILE_ZONE("scene");
+            // don't forget to enable shader before setting uniforms
+            modelShader.use();
+            modelShader.setFloat("material.shininess", 16.0f);
+            modelShader.setInt("blinnPhong", blinnPhong);
+            // render the loaded models
+            drawModels(modelShader, modelUniform, instancedUniform, indirectUniform);
         }
 
-        if(!gateClosed)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(6.55f, 0.0f, 2.05f));
-            model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.8f));
-            ourShader.setMat4("model", model);
-            fenceModel.Draw(ourShader);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(6.65f, 0.0f, -1.7f));
-            model = glm::rotate(model, glm::radians(-45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.8f));
-            ourShader.setMat4("model", model);
-            fenceModel.Draw(ourShader);
+            rg::GpuProfiler::Zone zone(profiler, PASS_PARALLAX_FLOOR);
+            RG_PROFILE_ZONE("parallax floor");
+            floorShader.use();
+            floorShader.setInt("blinnPhong", blinnPhong);
+            floorShader.setFloat("material.shininess", 1000.0f);
+            drawFloor(floorShader);
         }
-        else
+
+        if (depthPrepass)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(7.12f, 0.0f, 0.95f));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.8f));
-            ourShader.setMat4("model", model);
-            fenceModel.Draw(ourShader);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(7.12f, 0.0f, -0.4f));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.8f));
-            ourShader.setMat4("model", model);
-            fenceModel.Draw(ourShader);
-        }
-        // sheep model
-        for(unsigned int i = 0; i < sheepsInside.size(); i++){
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, sheepsInside[i]);
-            model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.6f));
-            ourShader.setMat4("model", model);
-            sheepModel.Draw(ourShader);
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
         }
 
-        for(unsigned int i = 0; i < sheepsOutside.size(); i++){
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, sheepsOutside[i]);
-            model = glm::rotate(model, glm::radians(15.0f * (float)pow(-1, i) * i), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.6f));
-            ourShader.setMat4("model", model);
-            sheepModel.Draw(ourShader);
+        if (deferred)
+        {
+            rg::GpuProfiler::Zone zone(profiler, PASS_LIGHTING);
+            RG_PROFILE_ZONE("lighting");
+            glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+            glClear(GL_COLOR_BUFFER_BIT);
+            deferredRenderer.Light(hdrFBO, projection * view, blinnPhong);
         }
 
-        // skybox shader setup
-        // -----------
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-
-        // render skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
-
-        // blending shader setup
-        blendingShader.use();
-        projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        view = camera.GetViewMatrix();
-        model = glm::mat4(1.0f);
-        blendingShader.setMat4("projection", projection);
-        blendingShader.setMat4("view", view);
+        {
+            rg::GpuProfiler::Zone zone(profiler, PASS_TERRAIN);
+            RG_PROFILE_ZONE("terrain");
+            // forward shaded in both paths, after the floor that covers it inside the village
+            terrain.Draw(pDiffuseMap);
+        }
 
-        // vegetation
-        glBindVertexArray(transparentVAO);
-        glBindTexture(GL_TEXTURE_2D, transparentTexture);
-        for (unsigned int i = 0; i < vegetation.size(); i++)
+        // the opaque scene is complete: its depth is what the next frame's instances are tested against
+        if (cullOnGpu && hiZOcclusion)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, vegetation[i]);
-            model = glm::scale(model, glm::vec3(7.0f));
-            blendingShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+            RG_PROFILE_ZONE("hi-z pyramid");
+            gpuCuller.BuildHiZ(hdrFBO, projection * view);
         }
-        for (unsigned int i = 0; i < vegetationRotated.size(); i++)
+
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, vegetationRotated[i]);
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(7.0f));
-            blendingShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+            rg::GpuProfiler::Zone zone(profiler, PASS_SKYBOX);
+            RG_PROFILE_ZONE("skybox");
+            // skybox shader setup
+            // -----------
+            glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+            skyboxShader.use();
+
+            // render skybox cube
+            rg::State().BindVertexArray(skyboxVAO);
+            rg::State().BindTexture(0, GL_TEXTURE_CUBE_MAP, cubemapTexture);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glDepthFunc(GL_LESS); // set depth function back to default
         }
 
+        {
+            rg::GpuProfiler::Zone zone(profiler, PASS_VEGETATION);
+            RG_PROFILE_ZONE("vegetation");
+            // blending shader setup
+            blendingShader.use();
+
+            // vegetation
+            rg::State().BindVertexArray(transparentVAO);
+            rg::State().BindTexture(0, GL_TEXTURE_2D, transparentTexture);
+            for (unsigned int i = 0; i < vegetation.size(); i++)
+            {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, vegetation[i]);
+                model = glm::scale(model, glm::vec3(7.0f));
+                if (!frustum.Intersects(rg::TransformSphere(vegetationCenter, vegetationRadius, model)))
+                    continue;
+                blendingShader.set(blendingModel, model);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            }
+            for (unsigned int i = 0; i < vegetationRotated.size(); i++)
+            {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, vegetationRotated[i]);
+                model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+                model = glm::scale(model, glm::vec3(7.0f));
+                if (!frustum.Intersects(rg::TransformSphere(vegetationCenter, vegetationRadius, model)))
+                    continue;
+                blendingShader.set(blendingModel, model);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            }
+        }
 
-        // configure view/projection matrices
-        glm::mat4 projection1 = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view1 = camera.GetViewMatrix();
-        shader.use();
-        shader.setMat4("projection", projection1);
-        shader.setMat4("view", view1);
-
-        // setup shader
-
-        // directional light
-        shader.setVec3("lightDir", -0.2f, -1.0f, -0.3f);
-        shader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        shader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        shader.setVec3("dirLight.diffuse", 0.1f, 0.1f, 0.1f);
-        shader.setVec3("dirLight.specular", 0.1f, 0.1f, 0.1f);
-        // point light 1
-        shader.setVec3("lightPos[0]", pointLightPositions[0]);
-        shader.setVec3("pointLight[0].position", pointLightPositions[0]);
-        shader.setVec3("pointLight[0].ambient", 0.05f, 0.05f, 0.05f);
-        shader.setVec3("pointLight[0].diffuse", 0.1f, 0.1f, 0.1f);
-        shader.setVec3("pointLight[0].specular", 0.1f, 0.1f, 0.1f);
-        shader.setFloat("pointLight[0].constant", 1.0f);
-        shader.setFloat("pointLight[0].linear", 0.09);
-        shader.setFloat("pointLight[0].quadratic", 0.032);
-        // point light 2
-        shader.setVec3("lightPos[1]", pointLightPositions[1]);
-        shader.setVec3("pointLight[1].position", pointLightPositions[1]);
-        shader.setVec3("pointLight[1].ambient", 0.05f, 0.05f, 0.05f);
-        shader.setVec3("pointLight[1].diffuse", 0.1f, 0.1f, 0.1f);
-        shader.setVec3("pointLight[1].specular", 0.1f, 0.1f, 0.1f);
-        shader.setFloat("pointLight[1].constant", 1.0f);
-        shader.setFloat("pointLight[1].linear", 0.09);
-        shader.setFloat("pointLight[1].quadratic", 0.032);
-        // point light 3
-        shader.setVec3("lightPos[2]", pointLightPositions[2]);
-        shader.setVec3("pointLight[2].position", pointLightPositions[2]);
-        shader.setVec3("pointLight[2].ambient", 0.05f, 0.05f, 0.05f);
-        shader.setVec3("pointLight[2].diffuse", 0.1f, 0.1f, 0.1f);
-        shader.setVec3("pointLight[2].specular", 0.1f, 0.1f, 0.1f);
-        shader.setFloat("pointLight[2].constant", 1.0f);
-        shader.setFloat("pointLight[2].linear", 0.09);
-        shader.setFloat("pointLight[2].quadratic", 0.032);
-        // point light 4
-        shader.setVec3("lightPos[3]", pointLightPositions[3]);
-        shader.setVec3("pointLight[3].position", pointLightPositions[3]);
-        shader.setVec3("pointLight[3].ambient", 0.05f, 0.05f, 0.05f);
-        shader.setVec3("pointLight[3].diffuse", 0.1f, 0.1f, 0.1f);
-        shader.setVec3("pointLight[3].specular", 0.1f, 0.1f, 0.1f);
-        shader.setFloat("pointLight[3].constant", 1.0f);
-        shader.setFloat("pointLight[3].linear", 0.09);
-        shader.setFloat("pointLight[3].quadratic", 0.032);
-
-        // render parallax-mapped quad
-        glm::mat4 model1 = glm::mat4(1.0f);
-        model1 = glm::translate(model1, glm::vec3(0.0f, 0.0f, 0.0f));
-        model1 = glm::rotate(model1, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model1 = glm::scale(model1, glm::vec3(12.5f));
-        shader.setMat4("model", model1);
-        shader.setVec3("viewPos", camera.Position);
-        shader.setInt("blinnPhong", blinnPhong);
-        shader.setFloat("material.shininess", 1000.0f);
-        shader.setFloat("heightScale", heightScale); // adjust with Q and E keys
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, pDiffuseMap);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pNormalMap);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, pHeightMap);
-        glEnable(GL_CULL_FACE);     // floor won't be visible if looked from bellow
-        glCullFace(GL_BACK);
-        renderQuad();
-        glDisable(GL_CULL_FACE);
-
-
-        // 2. blur bright fragments with two-pass Gaussian Blur
-        // --------------------------------------------------
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        blurShader.use();
-        for (unsigned int i = 0; i < amount; i++)
+        // 2. blur bright fragments through the bloom mip chain, unless bloom is off
+        // ------------------------------------------------------------------------
+        if (bloom)
         {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
-            renderQuadForBloom();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
+            rg::GpuProfiler::Zone zone(profiler, PASS_BLOOM);
+            RG_PROFILE_ZONE("bloom");
+            bloomChain.Render(colorBuffers[1], glm::ivec2(SCR_WIDTH, SCR_HEIGHT));
         }
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
         // --------------------------------------------------------------------------------------------------------------------------
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        bloomFinalShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        bloomFinalShader.setInt("bloom", bloom);
-        bloomFinalShader.setFloat("exposure", exposure);
-        renderQuadForBloom();
+        {
+            rg::GpuProfiler::Zone zone(profiler, PASS_COMPOSITE);
+            RG_PROFILE_ZONE("composite");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            bloomFinalShader.use();
+            rg::State().BindTexture(0, GL_TEXTURE_2D, colorBuffers[0]);
+            if (bloom)
+                rg::State().BindTexture(1, GL_TEXTURE_2D, bloomChain.Texture());
+            bloomFinalShader.setInt("bloom", bloom);
+            bloomFinalShader.setFloat("exposure", exposure);
+            renderQuadForBloom();
+        }
 
+        // profiler overlay, drawn over the finished frame
+        if (profilerOverlay && !benchmark.enabled)
+        {
+            RG_PROFILE_ZONE("overlay");
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+            DrawProfilerOverlay(profiler);
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
+        RG_PROFILE_BEGIN(swap, "swap buffers");
         glfwSwapBuffers(window);
         glfwPollEvents();
+        RG_PROFILE_END(swap);
+
+        if (benchmark.enabled)
+        {
+            double swap = glfwGetTime();
+            report.AddFrame(frame, (swap - previousSwap) * 1000.0);
+            previousSwap = swap;
+        }
+        frame++;
     }
 
+    if (benchmark.enabled)
+    {
+        profiler.Flush();
+        report.Write((const char*) glGetString(GL_RENDERER), SCR_WIDTH, SCR_HEIGHT, profiler);
+        report.Print(std::cout);
+    }
+    if (!benchmark.record.empty())
+        recordedPath.Save(benchmark.record);
+    RG_PROFILE_WRITE("trace.json");
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
@@ -1058,73 +1219,174 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
         gateClosed = !gateClosed;
     if (key == GLFW_KEY_M && action == GLFW_PRESS)
         blinnPhong = !blinnPhong;
+    if (key == GLFW_KEY_F2 && action == GLFW_PRESS)
+        rg::Resources().Report(std::cout);
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
+        profilerOverlay = !profilerOverlay;
+    if (key == GLFW_KEY_F4 && action == GLFW_PRESS)
+        deferred = !deferred;
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS)
+        depthPrepass = !depthPrepass;
+    if (key == GLFW_KEY_F6 && action == GLFW_PRESS)
+        multiDraw = !multiDraw;
+    if (key == GLFW_KEY_F7 && action == GLFW_PRESS)
+        gpuCulling = !gpuCulling;
+    if (key == GLFW_KEY_F8 && action == GLFW_PRESS)
+        hiZOcclusion = !hiZOcclusion;
 }
 
-unsigned int loadCubemap(vector<std::string> faces)
+// GPU and CPU time of every pass with graphs of the last frames; GPU times lag a few frames behind
+// ------------------------------------------------------------------------------------------------
+void DrawProfilerOverlay(const rg::GpuProfiler &profiler)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
+    ImGuiWindowFlags flags = ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing;
+    if (!cursorEnabled)
+        flags |= ImGuiWindowFlags_NoInputs;     // the mouse is flying the camera
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.7f);
+    if (ImGui::Begin("Profiler", NULL, flags))
     {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
+        double gpuTotal = 0.0, cpuTotal = 0.0;
+        for (unsigned int pass = 0; pass < profiler.PassCount(); pass++)
         {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
+            gpuTotal += profiler.GpuMilliseconds(pass);
+            cpuTotal += profiler.CpuMilliseconds(pass);
         }
-        else
+        ImGui::Text("frame %.2f ms   gpu %.2f ms   cpu %.2f ms", deltaTime * 1000.0f, gpuTotal, cpuTotal);
+        ImGui::Separator();
+        for (unsigned int pass = 0; pass < profiler.PassCount(); pass++)
         {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
+            ImGui::PushID(pass);
+            ImGui::Text("%-15s gpu %6.3f ms   cpu %6.3f ms", profiler.Name(pass).c_str(),
+                        profiler.GpuMilliseconds(pass), profiler.CpuMilliseconds(pass));
+            ImGui::PlotLines("##gpu", profiler.GpuHistory(pass), rg::GpuProfiler::HISTORY,
+                             profiler.HistoryOffset(), "gpu", 0.0f, FLT_MAX, ImVec2(240.0f, 30.0f));
+            ImGui::SameLine();
+            ImGui::PlotLines("##cpu", profiler.CpuHistory(pass), rg::GpuProfiler::HISTORY,
+                             profiler.HistoryOffset(), "cpu", 0.0f, FLT_MAX, ImVec2(240.0f, 30.0f));
+            ImGui::PopID();
         }
+        ImGui::Text("dropped gpu results: %llu", (unsigned long long) profiler.Dropped());
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    ImGui::End();
+}
 
-    return textureID;
+// the directional light and the UFO's spotlight, whose position is updated every frame
+// ---------------------------------------------------------------------------------------------
+rg::LightsBlock sceneLights()
+{
+    rg::LightsBlock lights = {};
+    lights.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    lights.dirLight.ambient = glm::vec3(0.05f);
+    lights.dirLight.diffuse = glm::vec3(0.1f);
+    lights.dirLight.specular = glm::vec3(0.1f);
+
+    lights.spotLight.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    lights.spotLight.ambient = glm::vec3(0.0f);
+    lights.spotLight.diffuse = glm::vec3(0.1f);
+    lights.spotLight.specular = glm::vec3(0.1f);
+    lights.spotLight.constant = 1.0f;
+    lights.spotLight.linear = 1.0f;
+    lights.spotLight.quadratic = 1.0f;
+    lights.spotLight.cutOff = glm::cos(glm::radians(12.5f));
+    lights.spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+    return lights;
 }
 
-unsigned int loadTexture(char const * path)
+// the lamps of the village
+// ---------------------------------------------------------------------------------------------
+vector<rg::PointLightBlock> villageLamps(const glm::vec3 *positions, int count)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    vector<rg::PointLightBlock> lamps;
+    for (int i = 0; i < count; i++)
+    {
+        rg::PointLightBlock lamp = {};
+        lamp.position = positions[i];
+        lamp.ambient = glm::vec3(0.05f);
+        lamp.diffuse = glm::vec3(0.1f);
+        lamp.specular = glm::vec3(0.1f);
+        lamp.constant = 1.0f;
+        lamp.linear = 0.09f;
+        lamp.quadratic = 0.032f;
+        lamps.push_back(lamp);
+    }
+    return lamps;
+}
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
+// a warm lamp hanging over every hut
+// ---------------------------------------------------------------------------------------------
+vector<rg::PointLightBlock> hutLamps(const vector<glm::vec3> &huts, const vector<glm::vec3> &hutsRotated)
+{
+    vector<glm::vec3> positions(huts);
+    positions.insert(positions.end(), hutsRotated.begin(), hutsRotated.end());
+
+    vector<rg::PointLightBlock> lamps;
+    for (const glm::vec3 &position : positions)
     {
-        GLenum format = GL_RED;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, (GLint)format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        rg::PointLightBlock lamp = {};
+        lamp.position = position + glm::vec3(0.0f, 2.5f, 0.0f);
+        lamp.ambient = glm::vec3(0.0f);
+        lamp.diffuse = glm::vec3(0.6f, 0.36f, 0.18f);
+        lamp.specular = glm::vec3(0.3f, 0.18f, 0.09f);
+        lamp.constant = 1.0f;
+        lamp.linear = 0.35f;
+        lamp.quadratic = 0.44f;
+        lamps.push_back(lamp);
+    }
+    return lamps;
+}
+
+// builds the fence instance transforms; the two gate pieces depend on whether the gate is closed
+// ---------------------------------------------------------------------------------------------
+vector<glm::mat4> fenceTransforms(const vector<glm::vec3> &fences, const vector<glm::vec3> &fencesRotated, bool gateClosed)
+{
+    vector<glm::mat4> transforms;
+    glm::mat4 model;
+    for (const glm::vec3 &position : fences)
+    {
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, position);
+        model = glm::scale(model, glm::vec3(0.8f));
+        transforms.push_back(model);
+    }
+    for (const glm::vec3 &position : fencesRotated)
+    {
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, position);
+        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.8f));
+        transforms.push_back(model);
+    }
 
-        stbi_image_free(data);
+    if (!gateClosed)
+    {
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(6.55f, 0.0f, 2.05f));
+        model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.8f));
+        transforms.push_back(model);
+
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(6.65f, 0.0f, -1.7f));
+        model = glm::rotate(model, glm::radians(-45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.8f));
+        transforms.push_back(model);
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(7.12f, 0.0f, 0.95f));
+        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.8f));
+        transforms.push_back(model);
 
-    return textureID;
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(7.12f, 0.0f, -0.4f));
+        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.8f));
+        transforms.push_back(model);
+    }
+    return transforms;
 }
 
 // renders a 1x1 quad in NDC with manually calculated tangent vectors
@@ -1204,7 +1466,7 @@ void renderQuad()
         // configure plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
+        rg::State().BindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -1218,9 +1480,8 @@ void renderQuad()
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(11 * sizeof(float)));
     }
-    glBindVertexArray(quadVAO);
+    rg::State().BindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
 }
 
 unsigned int quadVAO1 = 0;
@@ -1239,7 +1500,7 @@ void renderQuadForBloom()
         // setup plane VAO
         glGenVertexArrays(1, &quadVAO1);
         glGenBuffers(1, &quadVBO1);
-        glBindVertexArray(quadVAO1);
+        rg::State().BindVertexArray(quadVAO1);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO1);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -1247,7 +1508,6 @@ void renderQuadForBloom()
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     }
-    glBindVertexArray(quadVAO1);
+    rg::State().BindVertexArray(quadVAO1);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }